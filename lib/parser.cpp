@@ -1,118 +1,790 @@
-#include <future>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <tuple>
+#include <mutex>
+#include <deque>
+#include <stdexcept>
+#include <exception>
+#include <bit>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "parser.hpp"
 
-Predicate is(const char& c)
+// char classes
+
+CharClass::CharClass(): CharClass(std::bitset<256>()) {};
+
+CharClass::CharClass(const std::bitset<256> bytes): bytes(bytes)
+{
+    // index whichever side of the class is small enough to compare against directly
+    // neither side indexed leaves scan on the bitset, and only the full class scans non members with no needles
+    bool isScanningNonMembers = bytes.count() > 128;
+
+    if ((isScanningNonMembers ? 256 - bytes.count() : bytes.count()) > 8) return;
+
+    this->isScanningNonMembers = isScanningNonMembers;
+
+    for (int c = 0;c<256;c++) if (bytes.test(c) != this->isScanningNonMembers) this->scanBytes[this->scanByteCount++] = c;
+};
+
+CharClass::CharClass(const Predicate& predicate): CharClass([&predicate] {
+    // already compiled, nothing to evaluate
+    if (const CharClass* charClass = predicate.target<CharClass>()) return charClass->bytes;
+
+    std::bitset<256> bytes;
+
+    for (int c = 0;c<256;c++) if (predicate((char) c)) bytes.set(c);
+
+    return bytes;
+}()) {};
+
+bool CharClass::operator()(const char& c) const
+{
+    return this->bytes.test((unsigned char) c);
+};
+
+CharClass CharClass::operator|(const CharClass& other) const
+{
+    return CharClass(this->bytes | other.bytes);
+};
+
+CharClass CharClass::operator&(const CharClass& other) const
+{
+    return CharClass(this->bytes & other.bytes);
+};
+
+CharClass CharClass::operator~() const
+{
+    return CharClass(~this->bytes);
+};
+
+const std::bitset<256>& CharClass::getBytes() const
+{
+    return this->bytes;
+};
+
+int CharClass::scan(const char* begin, const char* end) const
+{
+    const char* c = begin;
+
+#ifdef __SSE2__
+    if (this->scanByteCount > 0 || this->isScanningNonMembers) {
+        __m128i needles[8];
+
+        for (int i = 0;i<this->scanByteCount;i++) needles[i] = _mm_set1_epi8(this->scanBytes[i]);
+
+        while (end - c >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) c);
+            __m128i equal = _mm_setzero_si128();
+
+            for (int i = 0;i<this->scanByteCount;i++) equal = _mm_or_si128(equal, _mm_cmpeq_epi8(chunk, needles[i]));
+
+            // bit i is set while byte i is still in the class
+            unsigned int memberMask = _mm_movemask_epi8(equal);
+
+            if (this->isScanningNonMembers) memberMask = ~memberMask & 0xFFFF;
+
+            if (memberMask != 0xFFFF) return c - begin + std::countr_one(memberMask);
+
+            c += 16;
+        }
+    }
+#endif
+
+    while (c != end && this->bytes.test((unsigned char) *c)) c++;
+
+    return c - begin;
+};
+
+CharClass is(const char& c)
+{
+    std::bitset<256> bytes;
+
+    bytes.set((unsigned char) c);
+
+    return CharClass(bytes);
+};
+
+CharClass negate(const CharClass& charClass) {
+    return ~charClass;
+};
+
+Predicate negate(const Predicate predicate) {
+    if (const CharClass* charClass = predicate.target<CharClass>()) return ~*charClass;
+
+    return [predicate] (const char& c) { return !predicate(c); };
+};
+
+CharClass anyOf(const std::initializer_list<CharClass> charClasses) {
+    CharClass anyCharClass;
+
+    for (const CharClass& charClass : charClasses) anyCharClass = anyCharClass | charClass;
+
+    return anyCharClass;
+};
+
+Predicate anyOf(const std::vector<Predicate> predicates) {
+    CharClass anyCharClass;
+
+    for (const Predicate& predicate : predicates) {
+        const CharClass* charClass = predicate.target<CharClass>();
+
+        if (charClass == nullptr) return [predicates] (const char& c) {
+            return std::any_of(predicates.begin(), predicates.end(), [&c] (const Predicate& predicate) { return predicate(c); });
+        };
+
+        anyCharClass = anyCharClass | *charClass;
+    }
+
+    return anyCharClass;
+};
+
+CharClass noneOf(const std::initializer_list<CharClass> charClasses) {
+    return ~anyOf(charClasses);
+};
+
+Predicate noneOf(const std::vector<Predicate> predicates) {
+    return negate(anyOf(predicates));
+};
+
+// first sets
+
+// a sequence starts with whatever its parts up to and including the first one that cant match nothing start with
+static std::pair<std::bitset<256>, bool> sequenceFirstSet(const std::vector<ParserCombinator>& tokenGeneratorSequence)
+{
+    std::bitset<256> firstSet;
+
+    for (const ParserCombinator& tokenGenerator : tokenGeneratorSequence) {
+        firstSet |= tokenGenerator.getFirstSet();
+
+        if (!tokenGenerator.isNullable()) return { firstSet, false };
+    }
+
+    return { firstSet, true };
+};
+
+static std::pair<std::bitset<256>, bool> choiceFirstSet(const std::vector<ParserCombinator>& tokenGeneratorChoices)
+{
+    std::bitset<256> firstSet;
+    bool nullable = false;
+
+    for (const ParserCombinator& tokenGenerator : tokenGeneratorChoices) {
+        firstSet |= tokenGenerator.getFirstSet();
+        nullable |= tokenGenerator.isNullable();
+    }
+
+    return { firstSet, nullable };
+};
+
+// token kinds
+
+class TokenKindTable
+{
+    public:
+        std::mutex mutex;
+
+        // names live in a deque so the views keying kinds stay valid as it grows
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, int> kinds;
+
+        TokenKindTable();
+};
+
+TokenKindTable::TokenKindTable()
+{
+    this->names.push_back("");
+    this->kinds[this->names.back()] = 0;
+};
+
+static TokenKindTable& tokenKindTable()
+{
+    static TokenKindTable table;
+
+    return table;
+};
+
+int Token::internKind(std::string_view id)
+{
+    auto& table = tokenKindTable();
+
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    auto existingKind = table.kinds.find(id);
+
+    if (existingKind != table.kinds.end()) return existingKind->second;
+
+    int kind = table.names.size();
+
+    table.names.emplace_back(id);
+    table.kinds[table.names.back()] = kind;
+
+    return kind;
+};
+
+// token arena
+
+class TokenArena: public std::enable_shared_from_this<TokenArena>
+{
+    public:
+        // a copy of the input of the parse, shared with the arenas of other threads working on the same parse
+        std::shared_ptr<const std::string> source;
+
+        const std::string* input = nullptr;
+
+        // every literal that is not a span of the source, offsets past the end of the source point in here
+        std::string literals;
+
+        std::vector<Token> children;
+
+        // children of the nests still being built, one stack shared by every combinator of the parse
+        std::vector<Token> pendingChildren;
+
+        // set once nothing is added anymore, copies taken from then on share ownership of the arena
+        // never set while tokens are still being stored, a stored token holding its own arena would keep it alive forever
+        bool isFinished = false;
+
+        int getSourceSize() const;
+
+        int addText(std::string_view literal);
+        std::string_view getText(int offset, int length) const;
+        int addChildren(std::span<const Token> nesting);
+
+        // a copy of token that belongs to this arena
+        Token adopt(const Token& token);
+};
+
+int TokenArena::getSourceSize() const
+{
+    return this->source == nullptr ? 0 : this->source->size();
+};
+
+int TokenArena::addText(std::string_view literal)
+{
+    int offset = this->getSourceSize() + this->literals.size();
+
+    this->literals.append(literal);
+
+    return offset;
+};
+
+std::string_view TokenArena::getText(int offset, int length) const
 {
-    return [c] (const char& testC) {
-        return c == testC;
+    int sourceSize = this->getSourceSize();
+
+    if (offset < sourceSize) return std::string_view(*this->source).substr(offset, length);
+
+    return std::string_view(this->literals).substr(offset - sourceSize, length);
+};
+
+int TokenArena::addChildren(std::span<const Token> nesting)
+{
+    // adopting can grow this->children, which nesting might point into
+    if (!nesting.empty() && !this->children.empty() && nesting.data() >= this->children.data() && nesting.data() < this->children.data() + this->children.size()) {
+        std::vector<Token> nestingCopy(nesting.begin(), nesting.end());
+
+        return this->addChildren(nestingCopy);
+    }
+
+    int offset = this->children.size();
+
+    this->children.resize(offset + nesting.size());
+
+    for (int i = 0;i<(int)nesting.size();i++) this->children[offset + i] = this->adopt(nesting[i]);
+
+    return offset;
+};
+
+Token TokenArena::adopt(const Token& token)
+{
+    Token adoptedToken = token;
+
+    adoptedToken.arena = this;
+    adoptedToken.owner.reset();
+
+    if (token.arena == this || token.arena == nullptr) return adoptedToken;
+
+    if (token.type == Token::TokenType::STRING_LITERAL) {
+        adoptedToken.offset = this->addText(token.getStringLiteralContent());
+
+        return adoptedToken;
+    }
+
+    // a nest from another arena, its subtree is copied over with an explicit stack
+    // [source token, index of its copy in this->children]
+    std::vector<std::pair<const Token*, int>> stack;
+
+    auto reserveChildren = [this, &stack] (Token& copy, const Token& source) {
+        auto sourceChildren = source.getNestingContent();
+
+        copy.offset = this->children.size();
+
+        this->children.resize(copy.offset + sourceChildren.size());
+
+        for (int i = 0;i<(int)sourceChildren.size();i++) stack.push_back({ &sourceChildren[i], copy.offset + i });
     };
+
+    reserveChildren(adoptedToken, token);
+
+    while (!stack.empty()) {
+        auto [source, index] = stack.back();
+
+        stack.pop_back();
+
+        Token copy = *source;
+
+        copy.arena = this;
+        copy.owner.reset();
+
+        if (source->type == Token::TokenType::STRING_LITERAL) copy.offset = this->addText(source->getStringLiteralContent());
+
+        else reserveChildren(copy, *source);
+
+        this->children[index] = copy;
+    }
+
+    return adoptedToken;
+};
+
+// memo and token arena of the parse running on this thread, see parse
+
+class ParseScope
+{
+    public:
+        // [id << 32 | position] = result, for positions of the input of this parse only
+        std::unordered_map<unsigned long long, ParserCombinatorResult> memo;
+
+        bool isMemoizingAll;
+
+        std::shared_ptr<TokenArena> arena;
+
+        ParseScope* previousScope;
+
+        ParseScope(const std::string& str, bool isMemoizingAll);
+        ParseScope(std::shared_ptr<const std::string> source, const std::string& str, bool isMemoizingAll);
+        ~ParseScope();
+
+        // the result of the whole parse, its token keeps the arena alive
+        ParserCombinatorResult release(ParserCombinatorResult result);
+};
+
+thread_local ParseScope* activeParseScope = nullptr;
+
+// one copy of the input up front, so literal tokens are spans of it rather than strings of their own
+ParseScope::ParseScope(const std::string& str, bool isMemoizingAll): ParseScope(std::make_shared<const std::string>(str), str, isMemoizingAll) {};
+
+ParseScope::ParseScope(std::shared_ptr<const std::string> source, const std::string& str, bool isMemoizingAll)
+{
+    this->isMemoizingAll = isMemoizingAll;
+
+    this->arena = std::make_shared<TokenArena>();
+    this->arena->source = source;
+    this->arena->input = &str;
+
+    this->previousScope = activeParseScope;
+
+    activeParseScope = this;
+};
+
+ParseScope::~ParseScope()
+{
+    this->arena->isFinished = true;
+
+    activeParseScope = this->previousScope;
+};
+
+ParserCombinatorResult ParseScope::release(ParserCombinatorResult result)
+{
+    if (getResultType(result) == ParserCombinatorResultType::TOKEN) {
+        // the input is done with, spans must not compare equal to a later parse reusing its address
+        this->arena->input = nullptr;
+
+        Token& token = std::get<Token>(result);
+
+        // a token from another arena (one of choiceConcurrent's workers) already keeps its own arena alive
+        if (token.arena != this->arena.get() && token.owner == nullptr) token = this->arena->adopt(token);
+
+        if (token.arena == this->arena.get()) token.owner = this->arena;
+    }
+
+    return result;
+};
+
+// alternatives of choiceConcurrent
+
+class ChoiceTask
+{
+    public:
+        enum State {
+            PENDING,
+            RUNNING,
+            DONE
+        };
+
+        const ParserCombinator* tokenGenerator;
+
+        // by reference, whoever submitted the task waits for it (or claims it) before the input can go away
+        const std::string* str;
+        int start;
+
+        int index;
+
+        // lowest index of an alternative that matched the rest of the input, shared by the whole choice
+        std::shared_ptr<std::atomic<int>> cancelAfter;
+
+        // the alternative this choice runs inside of, a cancelled parent cancels every choice below it
+        const ChoiceTask* parentTask;
+
+        std::shared_ptr<const std::string> source;
+        bool isMemoizingAll;
+
+        std::atomic<State> state = PENDING;
+
+        ParserCombinatorResult result = ParserFailure(0);
+
+        // thrown by the alternative, the submitter rethrows it once every alternative of the choice is done
+        std::exception_ptr exception;
+
+        bool tryClaim();
+        bool isCancelled() const;
+
+        // on the submitting thread the alternative runs in the parse already open there, elsewhere it gets a scope sharing the source
+        void run(bool isInline);
+};
+
+thread_local const ChoiceTask* activeChoiceTask = nullptr;
+
+bool ChoiceTask::tryClaim()
+{
+    State expectedState = PENDING;
+
+    return this->state.compare_exchange_strong(expectedState, RUNNING);
+};
+
+bool ChoiceTask::isCancelled() const
+{
+    for (auto task = this;task != nullptr;task = task->parentTask) {
+        if (task->cancelAfter->load(std::memory_order_relaxed) < task->index) return true;
+    }
+
+    return false;
+};
+
+void ChoiceTask::run(bool isInline)
+{
+    auto previousTask = activeChoiceTask;
+
+    activeChoiceTask = this;
+
+    try {
+        if (this->isCancelled()) this->result = ParserFailure(this->start);
+
+        else if (isInline) this->result = (*this->tokenGenerator)(*this->str, this->start);
+
+        else {
+            ParseScope parseScope(this->source, *this->str, this->isMemoizingAll);
+
+            this->result = parseScope.release((*this->tokenGenerator)(*this->str, this->start));
+        }
+    }
+    catch (...) {
+        // never escapes a worker, and the rest of the choice is cancelled since it is going to throw anyway
+        this->exception = std::current_exception();
+        this->result = ParserFailure(this->start);
+
+        this->cancelAfter->store(-1);
+    }
+
+    activeChoiceTask = previousTask;
+
+    // nothing after this index can beat a match that also took the terminating null (satisfy matches it), earlier alternatives still win ties
+    // a match that stops at the end of the text can still be beaten by one that goes on to match the null
+    if (getResultType(this->result) == ParserCombinatorResultType::TOKEN && this->start + std::get<Token>(this->result).width == (int) this->str->size() + 1) {
+        int cancelAfter = this->cancelAfter->load();
+
+        while (this->index < cancelAfter && !this->cancelAfter->compare_exchange_weak(cancelAfter, this->index));
+    }
+
+    this->state = DONE;
+    this->state.notify_all();
+};
+
+// nesting builder
+
+NestingBuilder::NestingBuilder()
+{
+    if (activeParseScope != nullptr) this->arena = activeParseScope->arena.get();
+
+    else {
+        // built outside of any parse, children are adopted into an arena of the builder's own as they are added
+        this->ownedArena = std::make_shared<TokenArena>();
+        this->arena = this->ownedArena.get();
+    }
+
+    this->base = this->arena->pendingChildren.size();
+};
+
+NestingBuilder::~NestingBuilder()
+{
+    this->arena->pendingChildren.resize(this->base);
+};
+
+void NestingBuilder::add(const Token& token)
+{
+    auto& pendingChildren = this->arena->pendingChildren;
+
+    if (token.kind != 0) pendingChildren.push_back(this->arena->adopt(token));
+
+    else if (token.type == Token::TokenType::NEST) {
+        for (const Token& child : token.getNestingContent()) pendingChildren.push_back(this->arena->adopt(child));
+    }
+};
+
+Token NestingBuilder::toToken(int kind, int start, int width)
+{
+    auto& pendingChildren = this->arena->pendingChildren;
+
+    Token token;
+
+    token.kind = kind;
+    token.type = Token::TokenType::NEST;
+    token.start = start;
+    token.width = width;
+    token.arena = this->arena;
+    token.offset = this->arena->addChildren(std::span<const Token>(pendingChildren.data() + this->base, pendingChildren.size() - this->base));
+    token.length = pendingChildren.size() - this->base;
+    token.owner = this->ownedArena;
+
+    if (this->ownedArena != nullptr) this->ownedArena->isFinished = true;
+
+    return token;
+};
+
+// token
+
+static TokenArena* ownArena(std::shared_ptr<const TokenArena>& owner)
+{
+    if (activeParseScope != nullptr) return activeParseScope->arena.get();
+
+    // built outside of any parse, so the token gets an arena of its own
+    auto arena = std::make_shared<TokenArena>();
+
+    owner = arena;
+
+    return arena.get();
+};
+
+Token::Token(std::string id, std::string stringLiteral, const int start, int width): Token(Token::internKind(id), std::string_view(stringLiteral), start, width) {};
+
+Token::Token(std::string id, std::vector<Token> nesting, const int start, int width): Token(Token::internKind(id), std::span<const Token>(nesting), start, width) {};
+
+Token::Token(int kind, std::string_view stringLiteral, int start, int width)
+{
+    TokenArena* arena = ownArena(this->owner);
+
+    this->kind = kind;
+    this->type = Token::TokenType::STRING_LITERAL;
+    this->start = start;
+    this->width = width;
+    this->arena = arena;
+    this->offset = arena->addText(stringLiteral);
+    this->length = stringLiteral.size();
+
+    if (this->owner != nullptr) arena->isFinished = true;
+};
+
+Token::Token(int kind, std::span<const Token> nesting, int start, int width)
+{
+    TokenArena* arena = ownArena(this->owner);
+
+    this->kind = kind;
+    this->type = Token::TokenType::NEST;
+    this->start = start;
+    this->width = width;
+    this->arena = arena;
+    this->offset = arena->addChildren(nesting);
+    this->length = nesting.size();
+
+    if (this->owner != nullptr) arena->isFinished = true;
+};
+
+Token::Token(const Token& other): kind(other.kind), type(other.type), start(other.start), width(other.width), offset(other.offset), length(other.length), arena(other.arena), owner(other.owner)
+{
+    this->shareArena();
+};
+
+Token& Token::operator=(const Token& other)
+{
+    this->kind = other.kind;
+    this->type = other.type;
+    this->start = other.start;
+    this->width = other.width;
+    this->offset = other.offset;
+    this->length = other.length;
+    this->arena = other.arena;
+    this->owner = other.owner;
+
+    this->shareArena();
+
+    return *this;
 };
 
-Predicate negate(const Predicate predicate) {
-    return [predicate] (const char& c) {
-        return !predicate(c);
-    };
+void Token::shareArena()
+{
+    // children stored in a finished arena have no owner of their own, so a copy of one would otherwise dangle once the root is gone
+    if (this->owner == nullptr && this->arena != nullptr && this->arena->isFinished) this->owner = this->arena->shared_from_this();
 };
 
-Predicate anyOf(const std::vector<Predicate> predicates) {
-    return [predicates] (const char& c) {
-        for (Predicate predicate : predicates) {
-            if (predicate(c)) return true;
-        }
+Token Token::span(int kind, const std::string& str, int start, int width)
+{
+    auto scope = activeParseScope;
 
-        return false;
-    };
-};
+    if (scope == nullptr || scope->arena->input != &str || start + width > (int) str.size()) return Token(kind, std::string_view(str).substr(start, width), start, width);
 
-Predicate noneOf(const std::vector<Predicate> predicates) {
-    return [predicates] (const char& c) {
-        for (Predicate predicate : predicates) {
-            if (predicate(c)) return false;
-        }
+    Token token;
 
-        return true;
-    };
-}
+    token.kind = kind;
+    token.type = Token::TokenType::STRING_LITERAL;
+    token.start = start;
+    token.width = width;
+    token.arena = scope->arena.get();
+    token.offset = start;
+    token.length = width;
 
-Token::Token(std::string id, std::string stringLiteral, const int start, int width)
-{
-    this->id = id;
-    this->type = Token::TokenType::STRING_LITERAL;
-    this->content = stringLiteral;
-    this->start = start;
-    this->width = width;
+    return token;
 };
 
-Token::Token(std::string id, std::vector<Token> NEST, const int start, int width)
+std::string_view Token::getId() const
 {
-    this->id = id;
-    this->type = Token::TokenType::NEST;
-    this->content = NEST;
-    this->start = start;
-    this->width = width;
+    auto& table = tokenKindTable();
+
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    return table.names[this->kind];
 };
 
-const std::string& Token::getStringLiteralContent() const
+std::string_view Token::getStringLiteralContent() const
 {
-    return std::get<std::string>(this->content);
+    if (this->type != Token::TokenType::STRING_LITERAL) throw std::runtime_error("Token getStringLiteralContent: token is a nest");
+
+    if (this->arena == nullptr) return std::string_view();
+
+    return this->arena->getText(this->offset, this->length);
 };
 
-const std::vector<Token>& Token::getNestingContent() const
+std::span<const Token> Token::getNestingContent() const
 {
-    return std::get<std::vector<Token>>(this->content);
+    if (this->type != Token::TokenType::NEST) throw std::runtime_error("Token getNestingContent: token is a string literal");
+
+    if (this->arena == nullptr) return std::span<const Token>();
+
+    return std::span<const Token>(this->arena->children.data() + this->offset, this->length);
 };
 
 std::string Token::toString() const
 {
-    return toString(0);
-};
+    // explicit stack instead of recursion so deeply nested tokens cant overflow the call stack
 
-std::string Token::toString(int indent) const
-{
-    std::string indentStr;
+    std::string output;
 
-    for (int i = 0;i<indent;i++) indentStr += ' ';
+    // [token, indent, index of the next child to print, -1 before the token itself is printed]
+    std::vector<std::tuple<const Token*, int, int>> stack = { { this, 0, -1 } };
 
-    if (this->type == Token::TokenType::STRING_LITERAL) {
-        return indentStr + this->id + " \"" + this->getStringLiteralContent() + "\"";
-    } else {
-        const std::vector<Token>& children = this->getNestingContent();
+    while (!stack.empty()) {
+        auto& [token, indent, nextChildIndex] = stack.back();
 
-        if (children.empty()) return indentStr + this->id;
+        std::string indentStr(indent, ' ');
 
-        std::string childrenString = "";
+        if (token->type == Token::TokenType::STRING_LITERAL) {
+            output.append(indentStr).append(token->getId()).append(" \"").append(token->getStringLiteralContent()).append("\"");
 
-        for (int i = 0;i<(int)children.size();i++) {
-            if (i == 0) childrenString += children[0].toString(indent + 4);
-            
-            else childrenString += ",\n" + children[i].toString(indent + 4);
+            stack.pop_back();
+
+            continue;
         }
 
-        return indentStr + this->id + " {\n" + childrenString + "\n" + indentStr + "}";
-    };
+        auto children = token->getNestingContent();
+
+        if (nextChildIndex == -1) {
+            if (children.empty()) {
+                output.append(indentStr).append(token->getId());
+
+                stack.pop_back();
+
+                continue;
+            }
+
+            output.append(indentStr).append(token->getId()).append(" {\n");
+
+            nextChildIndex = 0;
+        }
+
+        if (nextChildIndex == (int)children.size()) {
+            output += "\n" + indentStr + "}";
+
+            stack.pop_back();
+
+            continue;
+        }
+
+        if (nextChildIndex != 0) output += ",\n";
+
+        const Token* child = &children[nextChildIndex];
+        int childIndent = indent + 4;
+
+        // advance before pushing since the push can invalidate the frame reference
+        nextChildIndex++;
+
+        stack.push_back({ child, childIndent, -1 });
+    }
+
+    return output;
 };
 
 std::string Token::contentString() const
 {
-    if (this->type == Token::TokenType::STRING_LITERAL) return this->getStringLiteralContent();
+    std::string output;
 
-    std::string childrenString = "";
-    
-    for (const Token& child : this->getNestingContent()) childrenString += child.contentString();
+    std::vector<const Token*> stack = { this };
+
+    while (!stack.empty()) {
+        const Token* token = stack.back();
 
-    return childrenString;
+        stack.pop_back();
+
+        if (token->type == Token::TokenType::STRING_LITERAL) {
+            output += token->getStringLiteralContent();
+
+            continue;
+        }
+
+        auto children = token->getNestingContent();
+
+        // pushed in reverse so they pop in order
+        for (int i = children.size() - 1;i>=0;i--) stack.push_back(&children[i]);
+    }
+
+    return output;
+};
+
+std::string Token::id() const
+{
+    return std::string(this->getId());
 };
 
-inline void addChildToken(std::vector<Token>& parent, const Token& token)
+std::variant<std::string, std::vector<Token>> Token::content() const
 {
-    if (!token.id.empty()) parent.push_back(token);
+    if (this->type == Token::TokenType::STRING_LITERAL) return std::string(this->getStringLiteralContent());
 
-    else if(token.type == Token::TokenType::NEST) {
-        const std::vector<Token>& tokenChildren = token.getNestingContent();
+    auto children = this->getNestingContent();
 
-        parent.insert(parent.end(), tokenChildren.begin(), tokenChildren.end());
-    }
+    return std::vector<Token>(children.begin(), children.end());
 };
 
 ParserFailure::ParserFailure(int start)
@@ -153,29 +825,61 @@ std::string ParserFailure::toString() const
     return locationString + expectedString;
 };
 
-ParserCombinatorResultType getResultType(ParserCombinatorResult result)
+ParserCombinatorResultType getResultType(const ParserCombinatorResult& result)
 {
     return result.index() == 0 ? ParserCombinatorResultType::TOKEN : ParserCombinatorResultType::PARSER_FAILURE;
 };
 
-Token getTokenFromResult(ParserCombinatorResult result)
+Token getTokenFromResult(const ParserCombinatorResult& result)
 {
     return std::get<Token>(result);
 };
 
-ParserFailure getParserFailureFromResult(ParserCombinatorResult result)
+ParserFailure getParserFailureFromResult(const ParserCombinatorResult& result)
 {
     return std::get<ParserFailure>(result);
 };
 
 ParserCombinator::ParserCombinator(std::function<ParserCombinatorResult(const std::string&, const int)> implementation)
 {
+    // ids only need to be distinct within one parse, so wrapping around after 2^32 combinators is harmless in practice
+    static std::atomic<unsigned int> nextId = 1;
+
     this->implementation = implementation;
+    this->id = nextId++;
+
+    if (this->id == 0) this->id = nextId++;
 };
 
 ParserCombinatorResult ParserCombinator::operator()(const std::string& str, const int start) const
 {
-    return this->implementation(str, start);
+    auto scope = activeParseScope;
+
+    // cooperative cancellation, a losing alternative of choiceConcurrent stops at its next combinator
+    if (activeChoiceTask != nullptr && activeChoiceTask->isCancelled()) return ParserFailure(start);
+
+    // called outside of any parse, so this call is the whole parse
+    if (scope == nullptr) {
+        ParseScope parseScope(str, false);
+
+        return parseScope.release(this->implementation(str, start));
+    }
+
+    // the memo only describes the input of the parse, a call on any other string runs unmemoized
+    if (this->id == 0 || !(this->isMemoized || scope->isMemoizingAll) || scope->arena->input != &str) return this->implementation(str, start);
+
+    unsigned long long memoKey = ((unsigned long long) this->id << 32) | (unsigned int) start;
+
+    auto memoizedResult = scope->memo.find(memoKey);
+
+    if (memoizedResult != scope->memo.end()) return memoizedResult->second;
+
+    ParserCombinatorResult result = this->implementation(str, start);
+
+    // a cancelled result says nothing about the input
+    if (activeChoiceTask == nullptr || !activeChoiceTask->isCancelled()) scope->memo.emplace(memoKey, result);
+
+    return result;
 };
 
 ParserCombinator ParserCombinator::repeatedly() const
@@ -304,7 +1008,7 @@ ParserCombinator ParserCombinator::surroundedBy(const std::string wrapperTokenId
 
 ParserCombinator ParserCombinator::named(const std::string name) const
 {
-    return ParserCombinator([*this, name] (const std::string& str, const int start) -> ParserCombinatorResult {
+    ParserCombinator namedParserCombinator = ParserCombinator([*this, name] (const std::string& str, const int start) -> ParserCombinatorResult {
         ParserCombinatorResult result = (*this)(str, start);
         
         if (getResultType(result) == ParserCombinatorResultType::TOKEN) return result;
@@ -314,7 +1018,67 @@ ParserCombinator ParserCombinator::named(const std::string name) const
         std::string bestName = defaultParserFailure.name.empty() ? name : defaultParserFailure.name;
 
         return ParserFailure(defaultParserFailure.start, bestName);
-    });
+    }).withFirstSet(this->firstSet, this->nullable);
+
+    // a name only changes failures, so it still matches the same single bytes
+    namedParserCombinator.charClass = this->charClass;
+    namedParserCombinator.charKind = this->charKind;
+    namedParserCombinator.shape = this->shape;
+
+    return namedParserCombinator;
+};
+
+const std::bitset<256>& ParserCombinator::getFirstSet() const
+{
+    return this->firstSet;
+};
+
+bool ParserCombinator::isNullable() const
+{
+    return this->nullable;
+};
+
+const std::optional<CharClass>& ParserCombinator::getCharClass() const
+{
+    return this->charClass;
+};
+
+int ParserCombinator::getCharKind() const
+{
+    return this->charKind;
+};
+
+const std::shared_ptr<const ParserCombinatorShape>& ParserCombinator::getShape() const
+{
+    return this->shape;
+};
+
+ParserCombinator ParserCombinator::withShape(const std::shared_ptr<const ParserCombinatorShape> shape) const
+{
+    ParserCombinator parserCombinator = *this;
+
+    parserCombinator.shape = shape;
+
+    return parserCombinator;
+};
+
+ParserCombinator ParserCombinator::withFirstSet(const std::bitset<256> firstSet, const bool nullable) const
+{
+    ParserCombinator parserCombinator = *this;
+
+    parserCombinator.firstSet = firstSet;
+    parserCombinator.nullable = nullable;
+
+    return parserCombinator;
+};
+
+ParserCombinator ParserCombinator::memoized() const
+{
+    ParserCombinator memoizedParserCombinator = *this;
+
+    memoizedParserCombinator.isMemoized = true;
+
+    return memoizedParserCombinator;
 };
 
 ParserCombinator satisfy(const Predicate predicate)
@@ -322,17 +1086,55 @@ ParserCombinator satisfy(const Predicate predicate)
     return satisfy("", predicate);
 };
 
-ParserCombinator satisfy(const std::string tokenId, const Predicate predicate)
+// the terminating null is not part of the input text, so a match of it gets a literal of its own
+template <typename Test>
+static ParserCombinator satisfyCombinator(const int kind, const Test test)
 {
-    return ParserCombinator([tokenId, predicate] (const std::string& str, const int start) -> ParserCombinatorResult {
+    return ParserCombinator([kind, test] (const std::string& str, const int start) -> ParserCombinatorResult {
         const char& c = str[start];
 
-        if (predicate(c)) return Token(tokenId, std::string(1, c), start, 1);
+        if (!test(c)) return ParserFailure(start);
 
-        else return ParserFailure(start);
+        if (start == (int) str.size()) return Token(kind, std::string_view(&c, 1), start, 1);
+
+        else return Token::span(kind, str, start, 1);
     });
 };
 
+ParserCombinator satisfy(const std::string tokenId, const Predicate predicate)
+{
+    int kind = Token::internKind(tokenId);
+
+    const CharClass* charClass = predicate.target<CharClass>();
+
+    // any other predicate might depend on more than the character, so it is called per byte and nothing is known about it
+    if (charClass == nullptr) return satisfyCombinator(kind, predicate).withFirstSet(std::bitset<256>().set(), false);
+
+    ParserCombinator parserCombinator = satisfyCombinator(kind, *charClass).withFirstSet(charClass->getBytes(), false);
+
+    parserCombinator.charClass = *charClass;
+    parserCombinator.charKind = kind;
+    parserCombinator.shape = std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::SATISFY, *charClass, "", std::vector<ParserCombinator>(), 1, 1);
+
+    return parserCombinator;
+};
+
+// the matches of a single byte combinator are the run of its class, found without calling it per byte
+// anonymous bytes are dropped from nests anyway, so those runs only need their length
+static void scanCharClassRun(const ParserCombinator& nestedTokenGenerator, const std::string& str, const int maxCount, NestingBuilder& nestedTokens, int& tokensFound, int& scanStart)
+{
+    int scanWidth = std::min<long long>((int) str.size() - scanStart, (long long) maxCount - tokensFound);
+
+    int runWidth = nestedTokenGenerator.getCharClass()->scan(str.data() + scanStart, str.data() + scanStart + scanWidth);
+
+    int kind = nestedTokenGenerator.getCharKind();
+
+    if (kind != 0) for (int i = 0;i<runWidth;i++) nestedTokens.add(Token::span(kind, str, scanStart + i, 1));
+
+    tokensFound += runWidth;
+    scanStart += runWidth;
+};
+
 ParserCombinator repetition(const ParserCombinator nestedTokenGenerator)
 {
     return repetition("", nestedTokenGenerator);
@@ -360,13 +1162,17 @@ ParserCombinator repetition(const std::string tokenId, const ParserCombinator ne
 
 ParserCombinator repetition(const std::string tokenId, const ParserCombinator nestedTokenGenerator, const int minCount, const int maxCount)
 {
-    return ParserCombinator([tokenId, nestedTokenGenerator, minCount, maxCount] (const std::string& str, const int start) -> ParserCombinatorResult {
-        std::vector<Token> nestedTokens;
+    int kind = Token::internKind(tokenId);
+
+    return ParserCombinator([kind, nestedTokenGenerator, minCount, maxCount] (const std::string& str, const int start) -> ParserCombinatorResult {
+        NestingBuilder nestedTokens;
 
         int tokensFound = 0;
     
         int scanStart = start;
 
+        if (nestedTokenGenerator.getCharClass()) scanCharClassRun(nestedTokenGenerator, str, maxCount, nestedTokens, tokensFound, scanStart);
+
         while (scanStart != (int) str.size()) {
             if (tokensFound == maxCount) break;
 
@@ -374,21 +1180,21 @@ ParserCombinator repetition(const std::string tokenId, const ParserCombinator ne
 
             if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) break;
 
-            Token token = getTokenFromResult(result);
+            const Token& token = std::get<Token>(result);
 
             if (token.width == 0) break;
 
             tokensFound++;
 
-            addChildToken(nestedTokens, token);
+            nestedTokens.add(token);
 
             scanStart += token.width;
         }
 
         if (tokensFound < minCount) return ParserFailure(scanStart);
 
-        else return Token(tokenId, nestedTokens, start, scanStart - start);
-    });
+        else return nestedTokens.toToken(kind, start, scanStart - start);
+    }).withFirstSet(nestedTokenGenerator.getFirstSet(), minCount == 0).withShape(std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::REPETITION, CharClass(), "", std::vector<ParserCombinator>({ nestedTokenGenerator }), minCount, maxCount));
 };
 
 ParserCombinator strictlyRepetition(const ParserCombinator nestedTokenGenerator)
@@ -418,13 +1224,17 @@ ParserCombinator strictlyRepetition(const std::string tokenId, const ParserCombi
 
 ParserCombinator strictlyRepetition(const std::string tokenId, const ParserCombinator nestedTokenGenerator, const int minCount, const int maxCount)
 {
-    return ParserCombinator([tokenId, nestedTokenGenerator, minCount, maxCount] (const std::string& str, const int start) -> ParserCombinatorResult {
-        std::vector<Token> nestedTokens;
+    int kind = Token::internKind(tokenId);
+
+    return ParserCombinator([kind, nestedTokenGenerator, minCount, maxCount] (const std::string& str, const int start) -> ParserCombinatorResult {
+        NestingBuilder nestedTokens;
 
         int tokensFound = 0;
     
         int scanStart = start;
 
+        if (nestedTokenGenerator.getCharClass()) scanCharClassRun(nestedTokenGenerator, str, maxCount, nestedTokens, tokensFound, scanStart);
+
         while (scanStart != (int) str.size()) {
             if (tokensFound == maxCount) break;
 
@@ -432,13 +1242,13 @@ ParserCombinator strictlyRepetition(const std::string tokenId, const ParserCombi
 
             if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
 
-            Token token = getTokenFromResult(result);
+            const Token& token = std::get<Token>(result);
 
             if (token.width == 0) return ParserFailure(scanStart);
 
             tokensFound++;
 
-            addChildToken(nestedTokens, token);
+            nestedTokens.add(token);
 
             scanStart += token.width;
         }
@@ -447,8 +1257,8 @@ ParserCombinator strictlyRepetition(const std::string tokenId, const ParserCombi
 
         else if (tokensFound < minCount) return ParserFailure(scanStart);
 
-        else return Token(tokenId, nestedTokens, start, scanStart - start);
-    });
+        else return nestedTokens.toToken(kind, start, scanStart - start);
+    }).withFirstSet(nestedTokenGenerator.getFirstSet(), minCount == 0 || nestedTokenGenerator.isNullable());
 };
 
 ParserCombinator optional(const ParserCombinator tokenGenerator)
@@ -468,30 +1278,37 @@ ParserCombinator sequence(const std::vector<ParserCombinator> tokenGeneratorSequ
 
 ParserCombinator sequence(const std::string tokenId, const std::vector<ParserCombinator> tokenGeneratorSequence)
 {
-    return ParserCombinator([tokenId, tokenGeneratorSequence] (const std::string& str, const int start) -> ParserCombinatorResult {
-        std::vector<Token> sequenceTokens;
+    int kind = Token::internKind(tokenId);
+
+    auto [firstSet, nullable] = sequenceFirstSet(tokenGeneratorSequence);
+
+    return ParserCombinator([kind, tokenGeneratorSequence] (const std::string& str, const int start) -> ParserCombinatorResult {
+        NestingBuilder sequenceTokens;
 
         int scanOffset = 0;
 
-        for (ParserCombinator tokenGenerator : tokenGeneratorSequence) {
+        for (const ParserCombinator& tokenGenerator : tokenGeneratorSequence) {
             ParserCombinatorResult result = tokenGenerator(str, start + scanOffset);
 
             if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
 
-            Token token = getTokenFromResult(result);
+            const Token& token = std::get<Token>(result);
 
-            addChildToken(sequenceTokens, token);
+            sequenceTokens.add(token);
 
             scanOffset += token.width;
         }
 
-        return Token(tokenId, sequenceTokens, start, scanOffset);
-    });
+        return sequenceTokens.toToken(kind, start, scanOffset);
+    }).withFirstSet(firstSet, nullable).withShape(std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::SEQUENCE, CharClass(), "", tokenGeneratorSequence, 1, 1));
 };
 
 ParserCombinator strictlySequence(const std::vector<ParserCombinator> tokenGeneratorSequence) {
-    return ParserCombinator([tokenGeneratorSequence] (const std::string& str, const int start) -> ParserCombinatorResult {
-        ParserCombinatorResult result = sequence(tokenGeneratorSequence)(str, start);
+    // built once, so every call shares its id, first set and shape
+    auto sequenceTokenGenerator = sequence(tokenGeneratorSequence);
+
+    return ParserCombinator([sequenceTokenGenerator] (const std::string& str, const int start) -> ParserCombinatorResult {
+        ParserCombinatorResult result = sequenceTokenGenerator(str, start);
 
         if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
 
@@ -500,12 +1317,15 @@ ParserCombinator strictlySequence(const std::vector<ParserCombinator> tokenGener
         if (token.start + token.width == (int) str.size()) return token;
 
         else return ParserFailure(token.start + token.width, "end of input");
-    });
+    }).withFirstSet(sequenceTokenGenerator.getFirstSet(), sequenceTokenGenerator.isNullable());
 };
 
 ParserCombinator strictlySequence(const std::string tokenId, const std::vector<ParserCombinator> tokenGeneratorSequence) {
-    return ParserCombinator([tokenId, tokenGeneratorSequence] (const std::string& str, const int start) -> ParserCombinatorResult {
-        ParserCombinatorResult result = sequence(tokenId, tokenGeneratorSequence)(str, start);
+    // built once, so every call shares its id, first set and shape
+    auto sequenceTokenGenerator = sequence(tokenId, tokenGeneratorSequence);
+
+    return ParserCombinator([sequenceTokenGenerator] (const std::string& str, const int start) -> ParserCombinatorResult {
+        ParserCombinatorResult result = sequenceTokenGenerator(str, start);
 
         if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
 
@@ -514,7 +1334,7 @@ ParserCombinator strictlySequence(const std::string tokenId, const std::vector<P
         if (token.start + token.width == (int) str.size()) return token;
 
         else return ParserFailure(token.start + token.width, "end of input");
-    });
+    }).withFirstSet(sequenceTokenGenerator.getFirstSet(), sequenceTokenGenerator.isNullable());
 };
 
 ParserCombinator string(const std::string stringLiteral)
@@ -524,11 +1344,17 @@ ParserCombinator string(const std::string stringLiteral)
 
 ParserCombinator string(const std::string tokenId, const std::string stringLiteral)
 {
-    return ParserCombinator([tokenId, stringLiteral] (const std::string& str, const int start) -> ParserCombinatorResult {
-        if (stringLiteral != str.substr(start, stringLiteral.size())) return ParserFailure(start);
+    int kind = Token::internKind(tokenId);
+
+    std::bitset<256> firstSet;
+
+    if (!stringLiteral.empty()) firstSet.set((unsigned char) stringLiteral[0]);
+
+    return ParserCombinator([kind, stringLiteral] (const std::string& str, const int start) -> ParserCombinatorResult {
+        if (str.compare(start, stringLiteral.size(), stringLiteral) != 0) return ParserFailure(start);
         
-        else return Token(tokenId, stringLiteral, start, stringLiteral.size());
-    });
+        else return Token::span(kind, str, start, stringLiteral.size());
+    }).withFirstSet(firstSet, stringLiteral.empty()).withShape(std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::STRING, CharClass(), stringLiteral, std::vector<ParserCombinator>(), 1, 1));
 };
 
 ParserCombinator negate(const ParserCombinator tokenGenerator)
@@ -538,29 +1364,47 @@ ParserCombinator negate(const ParserCombinator tokenGenerator)
 
 ParserCombinator negate(const std::string tokenId, const ParserCombinator tokenGenerator)
 {
-    return ParserCombinator([tokenId, tokenGenerator] (const std::string& str, const int start) -> ParserCombinatorResult {
+    int kind = Token::internKind(tokenId);
+
+    return ParserCombinator([kind, tokenGenerator] (const std::string& str, const int start) -> ParserCombinatorResult {
         ParserCombinatorResult result = tokenGenerator(str, start);
 
         if (getResultType(result) == ParserCombinatorResultType::TOKEN) return ParserFailure(start);
 
-        else return Token(tokenId, std::vector<Token>(), start, 0);
+        else return Token(kind, std::span<const Token>(), start, 0);
     });
 };
 
 ParserCombinator choice(const std::vector<ParserCombinator> tokenGeneratorChoices)
 {
-    return ParserCombinator([tokenGeneratorChoices] (const std::string& str, const int start) -> ParserCombinatorResult {
+    auto [firstSet, nullable] = choiceFirstSet(tokenGeneratorChoices);
+
+    // [byte] = indexes of the alternatives that can match starting on that byte, in order
+    // the rest cant produce a token there, so they are only run when every candidate fails and the failures are needed
+    auto dispatchTable = std::make_shared<std::array<std::vector<int>, 256>>();
+
+    for (int i = 0;i<tokenGeneratorChoices.size();i++) {
+        const ParserCombinator& tokenGenerator = tokenGeneratorChoices[i];
+
+        for (int c = 0;c<256;c++) if (tokenGenerator.isNullable() || tokenGenerator.getFirstSet().test(c)) (*dispatchTable)[c].push_back(i);
+    }
+
+    return ParserCombinator([tokenGeneratorChoices, dispatchTable] (const std::string& str, const int start) -> ParserCombinatorResult {
         if (tokenGeneratorChoices.empty()) return ParserFailure(start);
 
+        const std::vector<int>& candidates = (*dispatchTable)[(unsigned char) str[start]];
+
         bool foundToken = false;
-        std::vector<ParserFailure> parseFailures;
         Token bestToken;
 
-        for (const ParserCombinator& tokenGenerator : tokenGeneratorChoices) {
-            ParserCombinatorResult result = tokenGenerator(str, start);
+        std::vector<ParserCombinatorResult> candidateResults;
+        candidateResults.reserve(candidates.size());
+
+        for (int candidate : candidates) {
+            ParserCombinatorResult result = tokenGeneratorChoices[candidate](str, start);
 
             if (getResultType(result) == ParserCombinatorResultType::TOKEN) {
-                Token token = getTokenFromResult(result);
+                const Token& token = std::get<Token>(result);
 
                 if (!foundToken || token.width > bestToken.width) {
                     foundToken = true;
@@ -568,41 +1412,233 @@ ParserCombinator choice(const std::vector<ParserCombinator> tokenGeneratorChoice
                     bestToken = token;
                 }
             }
-            else if (!foundToken) {
-                ParserFailure parseFailure = getParserFailureFromResult(result);
+            else if (!foundToken) candidateResults.push_back(std::move(result));
+        }
 
-                if (parseFailures.empty() || parseFailure.start > parseFailures[0].start) parseFailures = { parseFailure };
+        if (foundToken) return bestToken;
 
-                else if (parseFailure.start == parseFailures[0].start) parseFailures.push_back(parseFailure);
-            }
+        // every alternative failed, so collect failures from all of them in order to report exactly what a full scan would
+        std::vector<ParserFailure> parseFailures;
+
+        int candidateIndex = 0;
+
+        for (int i = 0;i<tokenGeneratorChoices.size();i++) {
+            bool isCandidate = candidateIndex < candidates.size() && candidates[candidateIndex] == i;
+
+            ParserFailure parseFailure = getParserFailureFromResult(isCandidate ? candidateResults[candidateIndex] : tokenGeneratorChoices[i](str, start));
+
+            if (isCandidate) candidateIndex++;
+
+            if (parseFailures.empty() || parseFailure.start > parseFailures[0].start) parseFailures = { parseFailure };
+
+            else if (parseFailure.start == parseFailures[0].start) parseFailures.push_back(parseFailure);
         }
 
-        if (foundToken) return bestToken;
+        return ParserFailure::composeFrom(parseFailures);
+    }).withFirstSet(firstSet, nullable).withShape(std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::CHOICE, CharClass(), "", tokenGeneratorChoices, 1, 1));
+};
 
-        else return ParserFailure::composeFrom(parseFailures);
-    });
+// one pool of workers for every choiceConcurrent in the program
+// each worker has its own queue, takes its newest task first and steals the oldest task of another worker when its own queue is empty
+
+class ChoicePool
+{
+    private:
+        class WorkerQueue
+        {
+            public:
+                std::mutex mutex;
+                std::deque<std::shared_ptr<ChoiceTask>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+
+        std::atomic<int> queuedTaskCount = 0;
+        std::atomic<unsigned int> nextQueue = 0;
+
+        // past this many queued tasks the pool counts as saturated
+        int maxQueuedTaskCount;
+
+        ChoicePool();
+
+        std::shared_ptr<ChoiceTask> takeTask(int workerIndex);
+
+        void work(int workerIndex);
+
+    public:
+        static ChoicePool& get();
+
+        // false when the pool is saturated, the caller runs the task itself
+        bool trySubmit(std::shared_ptr<ChoiceTask> task);
+};
+
+thread_local int activeWorkerIndex = -1;
+
+ChoicePool::ChoicePool()
+{
+    int workerCount = std::max(1, (int) std::thread::hardware_concurrency() - 1);
+
+    this->maxQueuedTaskCount = workerCount * 4;
+
+    for (int workerIndex = 0;workerIndex<workerCount;workerIndex++) this->queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (int workerIndex = 0;workerIndex<workerCount;workerIndex++) this->workers.emplace_back(&ChoicePool::work, this, workerIndex);
+};
+
+ChoicePool& ChoicePool::get()
+{
+    // never destroyed, workers are still blocked waiting for tasks when the program exits
+    static auto pool = new ChoicePool();
+
+    return *pool;
+};
+
+bool ChoicePool::trySubmit(std::shared_ptr<ChoiceTask> task)
+{
+    if (this->queuedTaskCount.load() >= this->maxQueuedTaskCount) return false;
+
+    // a worker submitting for a nested choice keeps the task on its own queue
+    int queueIndex = activeWorkerIndex != -1 ? activeWorkerIndex : this->nextQueue++ % this->queues.size();
+
+    auto& queue = *this->queues[queueIndex];
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+
+        this->queuedTaskCount++;
+    }
+
+    this->sleepCondition.notify_one();
+
+    return true;
+};
+
+std::shared_ptr<ChoiceTask> ChoicePool::takeTask(int workerIndex)
+{
+    int queueCount = this->queues.size();
+
+    for (int offset = 0;offset<queueCount;offset++) {
+        auto& queue = *this->queues[(workerIndex + offset) % queueCount];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty()) continue;
+
+        std::shared_ptr<ChoiceTask> task;
+
+        if (offset == 0) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+
+        this->queuedTaskCount--;
+
+        return task;
+    }
+
+    return nullptr;
+};
+
+void ChoicePool::work(int workerIndex)
+{
+    activeWorkerIndex = workerIndex;
+
+    while (true) {
+        auto task = this->takeTask(workerIndex);
+
+        if (task == nullptr) {
+            std::unique_lock<std::mutex> lock(this->sleepMutex);
+
+            this->sleepCondition.wait(lock, [this] () { return this->queuedTaskCount.load() > 0; });
+
+            continue;
+        }
+
+        // the submitter may have claimed it already while waiting on it
+        if (task->tryClaim()) task->run(false);
+    }
 };
 
 ParserCombinator choiceConcurrent(const std::vector<ParserCombinator> tokenGeneratorChoices)
 {
+    auto [firstSet, nullable] = choiceFirstSet(tokenGeneratorChoices);
+
     return ParserCombinator([tokenGeneratorChoices] (const std::string& str, const int start) -> ParserCombinatorResult {
         if (tokenGeneratorChoices.empty()) return ParserFailure(start);
-        
-        std::vector<std::future<ParserCombinatorResult>> tokenGeneratorThreads;
 
-        for (const ParserCombinator& tokenGenerator : tokenGeneratorChoices) tokenGeneratorThreads.push_back(std::async(std::launch::async, tokenGenerator, str, start));
+        auto scope = activeParseScope;
+
+        // workers share the source of this parse when str is its input, so no task copies the input
+        auto source = scope->arena->input == &str ? scope->arena->source : std::make_shared<const std::string>(str);
+
+        auto cancelAfter = std::make_shared<std::atomic<int>>(tokenGeneratorChoices.size());
+
+        std::vector<std::shared_ptr<ChoiceTask>> tasks;
 
-        std::vector<ParserCombinatorResult> tokenGeneratorResults;
+        for (int i = 0;i<(int)tokenGeneratorChoices.size();i++) {
+            auto task = std::make_shared<ChoiceTask>();
+
+            task->tokenGenerator = &tokenGeneratorChoices[i];
+            task->str = &str;
+            task->start = start;
+            task->index = i;
+            task->cancelAfter = cancelAfter;
+            task->parentTask = activeChoiceTask;
+            task->source = source;
+            task->isMemoizingAll = scope->isMemoizingAll;
+
+            tasks.push_back(task);
+        }
+
+        // the first alternative always runs here, the rest go to the pool unless it is saturated
+        auto& pool = ChoicePool::get();
+
+        for (int i = 1;i<(int)tasks.size();i++) pool.trySubmit(tasks[i]);
 
         bool foundToken = false;
         std::vector<ParserFailure> parseFailures;
         Token bestToken;
 
-        for (auto& thread : tokenGeneratorThreads) {
-            ParserCombinatorResult result = thread.get();
+        std::exception_ptr exception;
+
+        for (auto& task : tasks) {
+            // anything not picked up by a worker yet runs inline, otherwise wait for the worker to finish it
+            if (task->tryClaim()) task->run(true);
+
+            else {
+                auto state = task->state.load();
+
+                while (state != ChoiceTask::DONE) {
+                    task->state.wait(state);
+
+                    state = task->state.load();
+                }
+            }
+
+            // workers still hold str until their task is done, so the first exception waits for the rest of the tasks
+            if (task->exception != nullptr && exception == nullptr) exception = task->exception;
+
+            // cancelled alternatives cant have beaten the match that cancelled them
+            if (task->index > cancelAfter->load()) continue;
+
+            const ParserCombinatorResult& result = task->result;
 
             if (getResultType(result) == ParserCombinatorResultType::TOKEN) {
-                Token token = getTokenFromResult(result);
+                const Token& token = std::get<Token>(result);
 
                 if (!foundToken || token.width > bestToken.width) {
                     foundToken = true;
@@ -619,16 +1655,25 @@ ParserCombinator choiceConcurrent(const std::vector<ParserCombinator> tokenGener
             }
         }
 
+        if (exception != nullptr) std::rethrow_exception(exception);
+
         if (foundToken) return bestToken;
 
         else return ParserFailure::composeFrom(parseFailures);
-    });
+    }).withFirstSet(firstSet, nullable).withShape(std::make_shared<const ParserCombinatorShape>(ParserCombinatorShape::CHOICE, CharClass(), "", tokenGeneratorChoices, 1, 1));
 };
 
 ParserCombinator allOf(const std::string tokenId, const std::vector<ParserCombinator> tokenGeneratorRequirements)
 {
-    return ParserCombinator([tokenId, tokenGeneratorRequirements] (const std::string& str, const int start) -> ParserCombinatorResult {
-        std::vector<Token> tokens;
+    int kind = Token::internKind(tokenId);
+
+    // every requirement has to match, the union is a safe over approximation
+    auto [firstSet, nullable] = choiceFirstSet(tokenGeneratorRequirements);
+
+    nullable = std::all_of(tokenGeneratorRequirements.begin(), tokenGeneratorRequirements.end(), [] (const ParserCombinator& tokenGenerator) { return tokenGenerator.isNullable(); });
+
+    return ParserCombinator([kind, tokenGeneratorRequirements] (const std::string& str, const int start) -> ParserCombinatorResult {
+        NestingBuilder tokens;
         int largestTokenWidth = 0;
 
         for (const ParserCombinator& tokenGeneratorRequirement : tokenGeneratorRequirements) {
@@ -636,15 +1681,15 @@ ParserCombinator allOf(const std::string tokenId, const std::vector<ParserCombin
 
             if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
             
-            Token token = getTokenFromResult(result);
+            const Token& token = std::get<Token>(result);
 
-            addChildToken(tokens, token);
+            tokens.add(token);
 
             if (token.width > largestTokenWidth) largestTokenWidth = token.width;
         }
 
-        return Token(tokenId, tokens, start, largestTokenWidth);
-    });
+        return tokens.toToken(kind, start, largestTokenWidth);
+    }).withFirstSet(firstSet, nullable);
 };
 
 ParserCombinator noneOf(const std::vector<ParserCombinator> tokenGeneratorRequirements)
@@ -656,14 +1701,15 @@ ParserCombinator noneOf(const std::vector<ParserCombinator> tokenGeneratorRequir
             if (getResultType(result) == ParserCombinatorResultType::TOKEN) return ParserFailure(start);
         }
 
-        return Token("", std::vector<Token>(), start, 0);
+        return Token(0, std::span<const Token>(), start, 0);
     });
 };
 
 ParserCombinator proxyParserCombinator(const ParserCombinator* parserCombinatorPointer)
 {
     return ParserCombinator([parserCombinatorPointer] (const std::string& str, const int start) -> ParserCombinatorResult {
-        ParserCombinator proxiedParserCombinator = *parserCombinatorPointer;
+        // by reference, copying would copy the whole closure on every call
+        const ParserCombinator& proxiedParserCombinator = *parserCombinatorPointer;
 
         return proxiedParserCombinator(str, start);
     });
@@ -671,5 +1717,13 @@ ParserCombinator proxyParserCombinator(const ParserCombinator* parserCombinatorP
 
 ParserCombinatorResult parse(const std::string& str, const ParserCombinator parserCombinator)
 {
-    return parserCombinator(str, 0);
+    return parse(str, parserCombinator, DIRECT);
+};
+
+ParserCombinatorResult parse(const std::string& str, const ParserCombinator parserCombinator, const ParseMode mode)
+{
+    // the memo and arena live exactly as long as this parse, an enclosing parse on the same thread gets its own back afterwards
+    ParseScope parseScope(str, mode == PACKRAT);
+
+    return parseScope.release(parserCombinator(str, 0));
 };
\ No newline at end of file
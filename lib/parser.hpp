@@ -5,42 +5,148 @@
 #include <vector>
 #include <variant>
 #include <functional>
+#include <bitset>
+#include <string_view>
+#include <span>
+#include <memory>
+#include <optional>
+#include <initializer_list>
 
 typedef std::function<bool(const char&)> Predicate;
 
-Predicate is(const char& c);
+// a set of bytes, testing a character is one bit lookup instead of a chain of predicate calls
+// satisfy only compiles predicates that already are one of these, any other predicate is called per byte and may depend on more than the character
+class CharClass
+{
+    private:
+        std::bitset<256> bytes;
+
+        // classes with only a few members (or a few non members) are scanned 16 bytes at a time
+        unsigned char scanBytes[8];
+        int scanByteCount = 0;
+        bool isScanningNonMembers = false;
+
+    public:
+        CharClass();
+        explicit CharClass(const std::bitset<256> bytes);
+        // evaluates predicate once for every byte, so it must only depend on the character (isalpha reads the current locale, for one)
+        explicit CharClass(const Predicate& predicate);
+
+        bool operator()(const char& c) const;
+
+        CharClass operator|(const CharClass& other) const;
+        CharClass operator&(const CharClass& other) const;
+        CharClass operator~() const;
+
+        const std::bitset<256>& getBytes() const;
+
+        // length of the run of member bytes at the front of [begin, end)
+        int scan(const char* begin, const char* end) const;
+};
+
+CharClass is(const char& c);
+
+// combinations of char classes are char classes, combinations of any other predicate call it per character
+CharClass negate(const CharClass& charClass);
 Predicate negate(const Predicate predicate);
+CharClass anyOf(const std::initializer_list<CharClass> charClasses);
 Predicate anyOf(const std::vector<Predicate> predicates);
+CharClass noneOf(const std::initializer_list<CharClass> charClasses);
 Predicate noneOf(const std::vector<Predicate> predicates);
 
+class TokenArena;
+class ParserCombinatorShape;
+
+// tokens are small handles into the arena of the parse that produced them
+// literals are spans of the input text and nest children are contiguous runs of the arena, so copying a token never copies its subtree
+// a copy of any token of a finished parse, nested ones included, keeps the arena of the parse alive on its own
+// the views and spans the accessors return still borrow from the token they came from
 class Token
 {
-    private:
-        std::string toString(int indent) const;
-
     public:
-        std::string id;
+        // interned id, compare kinds instead of id strings
+        int kind = 0;
 
         enum TokenType {
             STRING_LITERAL,
             NEST
-        } type;
+        } type = STRING_LITERAL;
 
-        std::variant<std::string, std::vector<Token>> content;
-
-        int start;
-        int width;
+        int start = 0;
+        int width = 0;
 
         Token() = default;
     
         Token(std::string id, std::string stringLiteral, int start, int width);
         Token(std::string id, std::vector<Token> nesting, int start, int width);
 
-        const std::string& getStringLiteralContent() const;
-        const std::vector<Token>& getNestingContent() const;
+        Token(int kind, std::string_view stringLiteral, int start, int width);
+        Token(int kind, std::span<const Token> nesting, int start, int width);
+
+        // a moved token keeps whatever share of the arena it had, only copies can come from a finished arena without one
+        Token(const Token& other);
+        Token(Token&& other) noexcept = default;
+
+        Token& operator=(const Token& other);
+        Token& operator=(Token&& other) noexcept = default;
+
+        // literal over str[start, start + width), shares the text instead of copying it when str is the input of the running parse
+        static Token span(int kind, const std::string& str, int start, int width);
+
+        // the same id always gets the same kind, the empty id is kind 0
+        static int internKind(std::string_view id);
+
+        std::string_view getId() const;
+
+        std::string_view getStringLiteralContent() const;
+        std::span<const Token> getNestingContent() const;
 
         std::string toString() const;
         std::string contentString() const;
+
+        // copies in the shape of the former public members
+        [[deprecated("use getId, or compare kind")]] std::string id() const;
+        [[deprecated("use getStringLiteralContent or getNestingContent")]] std::variant<std::string, std::vector<Token>> content() const;
+
+    private:
+        // [offset, offset + length) of the arena text for literals, of the arena children for nests
+        int offset = 0;
+        int length = 0;
+
+        const TokenArena* arena = nullptr;
+
+        // set on every copy made once the arena is finished, tokens stored in the arena itself never hold it
+        std::shared_ptr<const TokenArena> owner;
+
+        // takes a share of the arena when it is finished and this token does not hold one yet
+        void shareArena();
+
+        friend class TokenArena;
+        friend class ParseScope;
+        friend class NestingBuilder;
+};
+
+// collects the children of a nest, splicing in the children of anonymous nests like every built in combinator does
+// inside a parse the children go on a stack shared by the whole parse, so building a nest does not allocate
+class NestingBuilder
+{
+    private:
+        TokenArena* arena;
+        int base;
+
+        // only used outside of a parse
+        std::shared_ptr<TokenArena> ownedArena;
+
+    public:
+        NestingBuilder();
+        ~NestingBuilder();
+
+        NestingBuilder(const NestingBuilder&) = delete;
+        NestingBuilder& operator=(const NestingBuilder&) = delete;
+
+        void add(const Token& token);
+
+        Token toToken(int kind, int start, int width);
 };
 
 class ParserFailure
@@ -66,15 +172,39 @@ enum ParserCombinatorResultType
 
 typedef std::variant<Token, ParserFailure> ParserCombinatorResult;
 
-ParserCombinatorResultType getResultType(ParserCombinatorResult result);
-Token getTokenFromResult(ParserCombinatorResult result);
-ParserFailure getParserFailureFromResult(ParserCombinatorResult result);
+ParserCombinatorResultType getResultType(const ParserCombinatorResult& result);
+Token getTokenFromResult(const ParserCombinatorResult& result);
+ParserFailure getParserFailureFromResult(const ParserCombinatorResult& result);
+
+enum ParseMode
+{
+    DIRECT, // only combinators marked with ParserCombinator::memoized are memoized
+    PACKRAT // every combinator is memoized, linear time at the cost of memory
+};
 
 class ParserCombinator
 {
     private:
         std::function<ParserCombinatorResult(const std::string&, const int)> implementation;
 
+        // shared by copies, identifies the combinator in the packrat memo (0 for an empty combinator)
+        unsigned int id = 0;
+
+        bool isMemoized = false;
+
+        // bytes a match can start with and whether it can match nothing
+        // conservative (every byte, nullable) unless the combinator was built from parts whose sets are known
+        std::bitset<256> firstSet = std::bitset<256>().set();
+        bool nullable = true;
+
+        // set when the combinator matches exactly one byte of a class, so repetitions of it scan runs instead of calling it per byte
+        std::optional<CharClass> charClass;
+        int charKind = 0;
+
+        std::shared_ptr<const ParserCombinatorShape> shape;
+
+        friend ParserCombinator satisfy(const std::string tokenId, const Predicate predicate);
+
     public:
         ParserCombinator() = default;
 
@@ -109,8 +239,50 @@ class ParserCombinator
         ParserCombinator surroundedBy(const std::string wrapperTokenId, const ParserCombinator neighbor) const;
 
         ParserCombinator named(const std::string name) const;
+
+        // results are kept by (combinator, position) for the rest of the enclosing parse, for combinators that get reparsed at the same position
+        ParserCombinator memoized() const;
+
+        const std::bitset<256>& getFirstSet() const;
+        bool isNullable() const;
+
+        const std::optional<CharClass>& getCharClass() const;
+        int getCharKind() const;
+
+        // declares what a combinator built from a plain function can start with, so choice can skip it on other bytes
+        ParserCombinator withFirstSet(const std::bitset<256> firstSet, const bool nullable) const;
+
+        // null unless the combinator came straight from one of the factories a shape describes
+        const std::shared_ptr<const ParserCombinatorShape>& getShape() const;
+
+        ParserCombinator withShape(const std::shared_ptr<const ParserCombinatorShape> shape) const;
+};
+
+// how a combinator was built, so passes over a grammar (see LexicalScanner) can look through it
+// only satisfy of a CharClass, string, sequence, choice and repetition (and optional, which is a repetition) record one
+class ParserCombinatorShape
+{
+    public:
+        enum ShapeType {
+            SATISFY,
+            STRING,
+            SEQUENCE,
+            CHOICE,
+            REPETITION
+        } type;
+
+        CharClass charClass;
+        std::string stringLiteral;
+
+        std::vector<ParserCombinator> children;
+
+        int minCount;
+        int maxCount;
+
+        ParserCombinatorShape(ShapeType type, CharClass charClass, std::string stringLiteral, std::vector<ParserCombinator> children, int minCount, int maxCount): type(type), charClass(charClass), stringLiteral(stringLiteral), children(children), minCount(minCount), maxCount(maxCount) {};
 };
 
+// matches one byte the predicate accepts, a CharClass predicate also gets a first set, run scanning and a shape
 ParserCombinator satisfy(const Predicate predicate);
 ParserCombinator satisfy(const std::string tokenId, const Predicate predicate);
 
@@ -152,5 +324,6 @@ ParserCombinator noneOf(const std::vector<ParserCombinator> tokenGeneratorRequir
 ParserCombinator proxyParserCombinator(const ParserCombinator* parserCombinatorPointer);
 
 ParserCombinatorResult parse(const std::string& str, const ParserCombinator parserCombinator);
+ParserCombinatorResult parse(const std::string& str, const ParserCombinator parserCombinator, const ParseMode mode);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,401 @@
+#ifndef STATIC_PARSER_HPP
+#define STATIC_PARSER_HPP
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <concepts>
+
+#include "parser.hpp"
+
+// statically typed counterparts of the combinators in parser.hpp
+// composition is encoded in the types, so predicates and nested combinators are called directly (and inlined) instead of through std::function
+// every combinator offers
+//     match(str, start)      -> end of the match or -1, builds no tokens
+//     operator()(str, start) -> the same ParserCombinatorResult the parser.hpp combinator of the same name produces
+// parse(str) runs the grammar as a whole parse, and erase() turns a whole typed grammar back into a ParserCombinator at a grammar boundary
+
+namespace static_parser
+{
+    template <typename C>
+    concept Combinator = requires(const C combinator, const std::string& str, int start) {
+        { combinator.match(str, start) } -> std::same_as<int>;
+        { combinator(str, start) } -> std::same_as<ParserCombinatorResult>;
+    };
+
+    template <typename Derived>
+    class CombinatorBase;
+
+    template <typename P>
+    class Satisfy;
+
+    class String;
+
+    template <typename... Cs>
+    class Sequence;
+
+    template <typename... Cs>
+    class Choice;
+
+    template <typename C>
+    class Repetition;
+
+    class Dynamic;
+
+    // fluent helpers shared by every typed combinator, mirroring the ParserCombinator members
+    template <typename Derived>
+    class CombinatorBase
+    {
+        public:
+            template <Combinator Successor>
+            Sequence<Derived, Successor> followedBy(const Successor& successor) const { return Sequence<Derived, Successor>("", static_cast<const Derived&>(*this), successor); };
+
+            template <Combinator Successor>
+            Sequence<Derived, Successor> followedBy(const std::string wrapperTokenId, const Successor& successor) const { return Sequence<Derived, Successor>(wrapperTokenId, static_cast<const Derived&>(*this), successor); };
+
+            template <Combinator Predecessor>
+            Sequence<Predecessor, Derived> precededBy(const Predecessor& predecessor) const { return Sequence<Predecessor, Derived>("", predecessor, static_cast<const Derived&>(*this)); };
+
+            template <Combinator Predecessor>
+            Sequence<Predecessor, Derived> precededBy(const std::string wrapperTokenId, const Predecessor& predecessor) const { return Sequence<Predecessor, Derived>(wrapperTokenId, predecessor, static_cast<const Derived&>(*this)); };
+
+            template <Combinator Neighbor>
+            Sequence<Neighbor, Derived, Neighbor> surroundedBy(const Neighbor& neighbor) const { return Sequence<Neighbor, Derived, Neighbor>("", neighbor, static_cast<const Derived&>(*this), neighbor); };
+
+            template <Combinator Neighbor>
+            Sequence<Neighbor, Derived, Neighbor> surroundedBy(const std::string wrapperTokenId, const Neighbor& neighbor) const { return Sequence<Neighbor, Derived, Neighbor>(wrapperTokenId, neighbor, static_cast<const Derived&>(*this), neighbor); };
+
+            Repetition<Derived> repeatedly() const { return Repetition<Derived>("", static_cast<const Derived&>(*this), 0, std::numeric_limits<int>::max()); };
+            Repetition<Derived> repeatedly(const int minCount) const { return Repetition<Derived>("", static_cast<const Derived&>(*this), minCount, std::numeric_limits<int>::max()); };
+            Repetition<Derived> repeatedly(const int minCount, const int maxCount) const { return Repetition<Derived>("", static_cast<const Derived&>(*this), minCount, maxCount); };
+
+            Repetition<Derived> optionally() const { return Repetition<Derived>("", static_cast<const Derived&>(*this), 0, 1); };
+            Repetition<Derived> optionally(const std::string wrapperTokenId) const { return Repetition<Derived>(wrapperTokenId, static_cast<const Derived&>(*this), 0, 1); };
+
+            // runs as a whole parse, so every token shares one arena instead of each call outside a parse getting its own
+            ParserCombinatorResult parse(const std::string& str) const { return ::parse(str, this->erase()); };
+
+            // type erased adapter, the result plugs into any parser.hpp combinator
+            ParserCombinator erase() const
+            {
+                Derived combinator = static_cast<const Derived&>(*this);
+
+                return ParserCombinator([combinator] (const std::string& str, const int start) -> ParserCombinatorResult {
+                    return combinator(str, start);
+                });
+            };
+    };
+
+    template <typename P>
+    class Satisfy: public CombinatorBase<Satisfy<P>>
+    {
+        private:
+            int kind;
+            P predicate;
+
+        public:
+            Satisfy(std::string tokenId, P predicate): kind(Token::internKind(tokenId)), predicate(predicate) {};
+
+            // like satisfy, the predicate also sees the terminating null at the end of the input
+            int match(const std::string& str, int start) const
+            {
+                if (start > (int) str.size() || !this->predicate(str[start])) return -1;
+
+                return start + 1;
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                if (this->match(str, start) == -1) return ParserFailure(start);
+
+                // the terminating null is not part of the input text
+                if (start == (int) str.size()) return Token(this->kind, std::string_view(&str[start], 1), start, 1);
+
+                return Token::span(this->kind, str, start, 1);
+            };
+    };
+
+    class String: public CombinatorBase<String>
+    {
+        private:
+            int kind;
+            std::string stringLiteral;
+
+        public:
+            String(std::string tokenId, std::string stringLiteral): kind(Token::internKind(tokenId)), stringLiteral(stringLiteral) {};
+
+            int match(const std::string& str, int start) const
+            {
+                if (str.compare(start, this->stringLiteral.size(), this->stringLiteral) != 0) return -1;
+
+                return start + this->stringLiteral.size();
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                if (this->match(str, start) == -1) return ParserFailure(start);
+
+                return Token::span(this->kind, str, start, this->stringLiteral.size());
+            };
+    };
+
+    template <typename... Cs>
+    class Sequence: public CombinatorBase<Sequence<Cs...>>
+    {
+        private:
+            int kind;
+            std::tuple<Cs...> combinators;
+
+        public:
+            Sequence(std::string tokenId, Cs... combinators): kind(Token::internKind(tokenId)), combinators(combinators...) {};
+
+            int match(const std::string& str, int start) const
+            {
+                int end = start;
+
+                // folds over the tuple, stopping at the first failure
+                std::apply([&str, &end] (const Cs&... combinators) {
+                    ((end = end == -1 ? -1 : combinators.match(str, end)), ...);
+                }, this->combinators);
+
+                return end;
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                NestingBuilder sequenceTokens;
+
+                int scanOffset = 0;
+
+                std::optional<ParserFailure> parserFailure;
+
+                std::apply([&] (const Cs&... combinators) {
+                    auto step = [&] (const auto& combinator) {
+                        if (parserFailure.has_value()) return;
+
+                        ParserCombinatorResult result = combinator(str, start + scanOffset);
+
+                        if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) {
+                            parserFailure = getParserFailureFromResult(result);
+
+                            return;
+                        }
+
+                        const Token& token = std::get<Token>(result);
+
+                        sequenceTokens.add(token);
+
+                        scanOffset += token.width;
+                    };
+
+                    (step(combinators), ...);
+                }, this->combinators);
+
+                if (parserFailure.has_value()) return parserFailure.value();
+
+                return sequenceTokens.toToken(this->kind, start, scanOffset);
+            };
+    };
+
+    // longest match wins, the earlier alternative on ties
+    template <typename... Cs>
+    class Choice: public CombinatorBase<Choice<Cs...>>
+    {
+        private:
+            std::tuple<Cs...> combinators;
+
+        public:
+            Choice(Cs... combinators): combinators(combinators...) {};
+
+            int match(const std::string& str, int start) const
+            {
+                int bestEnd = -1;
+
+                std::apply([&] (const Cs&... combinators) {
+                    ((bestEnd = std::max(bestEnd, combinators.match(str, start))), ...);
+                }, this->combinators);
+
+                return bestEnd;
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                bool foundToken = false;
+                std::vector<ParserFailure> parseFailures;
+                Token bestToken;
+
+                std::apply([&] (const Cs&... combinators) {
+                    auto attempt = [&] (const auto& combinator) {
+                        ParserCombinatorResult result = combinator(str, start);
+
+                        if (getResultType(result) == ParserCombinatorResultType::TOKEN) {
+                            const Token& token = std::get<Token>(result);
+
+                            if (!foundToken || token.width > bestToken.width) {
+                                foundToken = true;
+
+                                bestToken = token;
+                            }
+                        }
+                        else if (!foundToken) {
+                            ParserFailure parseFailure = getParserFailureFromResult(result);
+
+                            if (parseFailures.empty() || parseFailure.start > parseFailures[0].start) parseFailures = { parseFailure };
+
+                            else if (parseFailure.start == parseFailures[0].start) parseFailures.push_back(parseFailure);
+                        }
+                    };
+
+                    (attempt(combinators), ...);
+                }, this->combinators);
+
+                if (foundToken) return bestToken;
+
+                if (parseFailures.empty()) return ParserFailure(start);
+
+                return ParserFailure::composeFrom(parseFailures);
+            };
+    };
+
+    template <typename C>
+    class Repetition: public CombinatorBase<Repetition<C>>
+    {
+        private:
+            int kind;
+            C combinator;
+            int minCount;
+            int maxCount;
+
+        public:
+            Repetition(std::string tokenId, C combinator, int minCount, int maxCount): kind(Token::internKind(tokenId)), combinator(combinator), minCount(minCount), maxCount(maxCount) {};
+
+            int match(const std::string& str, int start) const
+            {
+                int tokensFound = 0;
+
+                int scanStart = start;
+
+                while (scanStart != (int) str.size() && tokensFound != this->maxCount) {
+                    int end = this->combinator.match(str, scanStart);
+
+                    if (end == -1 || end == scanStart) break;
+
+                    tokensFound++;
+
+                    scanStart = end;
+                }
+
+                return tokensFound < this->minCount ? -1 : scanStart;
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                NestingBuilder nestedTokens;
+
+                int tokensFound = 0;
+
+                int scanStart = start;
+
+                while (scanStart != (int) str.size() && tokensFound != this->maxCount) {
+                    ParserCombinatorResult result = this->combinator(str, scanStart);
+
+                    if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) break;
+
+                    const Token& token = std::get<Token>(result);
+
+                    if (token.width == 0) break;
+
+                    tokensFound++;
+
+                    nestedTokens.add(token);
+
+                    scanStart += token.width;
+                }
+
+                if (tokensFound < this->minCount) return ParserFailure(scanStart);
+
+                return nestedTokens.toToken(this->kind, start, scanStart - start);
+            };
+    };
+
+    // the other direction of the adapter, lets a typed grammar call into a ParserCombinator (e.g. a proxyParserCombinator for recursion)
+    class Dynamic: public CombinatorBase<Dynamic>
+    {
+        private:
+            ParserCombinator parserCombinator;
+
+        public:
+            Dynamic(ParserCombinator parserCombinator): parserCombinator(parserCombinator) {};
+
+            int match(const std::string& str, int start) const
+            {
+                ParserCombinatorResult result = this->parserCombinator(str, start);
+
+                if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return -1;
+
+                return start + std::get<Token>(result).width;
+            };
+
+            ParserCombinatorResult operator()(const std::string& str, int start) const
+            {
+                return this->parserCombinator(str, start);
+            };
+    };
+
+    // factories, named like their parser.hpp counterparts
+
+    template <typename P>
+    requires std::predicate<const P&, char>
+    Satisfy<P> satisfy(P predicate) { return Satisfy<P>("", predicate); };
+
+    template <typename P>
+    requires std::predicate<const P&, char>
+    Satisfy<P> satisfy(const std::string tokenId, P predicate) { return Satisfy<P>(tokenId, predicate); };
+
+    // a plain character instead of a predicate, the typed form of satisfy(is(c))
+    inline auto is(char c) { return [c] (char testC) { return testC == c; }; };
+
+    inline String string(const std::string stringLiteral) { return String("", stringLiteral); };
+    inline String string(const std::string tokenId, const std::string stringLiteral) { return String(tokenId, stringLiteral); };
+
+    template <Combinator... Cs>
+    Sequence<Cs...> sequence(Cs... combinators) { return Sequence<Cs...>("", combinators...); };
+
+    template <Combinator... Cs>
+    Sequence<Cs...> sequence(const std::string tokenId, Cs... combinators) { return Sequence<Cs...>(tokenId, combinators...); };
+
+    template <Combinator... Cs>
+    Choice<Cs...> choice(Cs... combinators) { return Choice<Cs...>(combinators...); };
+
+    template <Combinator C>
+    Repetition<C> repetition(C combinator) { return Repetition<C>("", combinator, 0, std::numeric_limits<int>::max()); };
+
+    template <Combinator C>
+    Repetition<C> repetition(C combinator, const int minCount) { return Repetition<C>("", combinator, minCount, std::numeric_limits<int>::max()); };
+
+    template <Combinator C>
+    Repetition<C> repetition(C combinator, const int minCount, const int maxCount) { return Repetition<C>("", combinator, minCount, maxCount); };
+
+    template <Combinator C>
+    Repetition<C> repetition(const std::string tokenId, C combinator) { return Repetition<C>(tokenId, combinator, 0, std::numeric_limits<int>::max()); };
+
+    template <Combinator C>
+    Repetition<C> repetition(const std::string tokenId, C combinator, const int minCount) { return Repetition<C>(tokenId, combinator, minCount, std::numeric_limits<int>::max()); };
+
+    template <Combinator C>
+    Repetition<C> repetition(const std::string tokenId, C combinator, const int minCount, const int maxCount) { return Repetition<C>(tokenId, combinator, minCount, maxCount); };
+
+    template <Combinator C>
+    Repetition<C> optional(C combinator) { return Repetition<C>("", combinator, 0, 1); };
+
+    template <Combinator C>
+    Repetition<C> optional(const std::string tokenId, C combinator) { return Repetition<C>(tokenId, combinator, 0, 1); };
+
+    inline Dynamic dynamic(ParserCombinator parserCombinator) { return Dynamic(parserCombinator); };
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include <stdexcept>
+
+#include "big_count.hpp"
+
+BigCount::BigCount(unsigned int value)
+{
+    while (value != 0) {
+        this->limbs.push_back(value % base);
+
+        value /= base;
+    }
+};
+
+void BigCount::trim()
+{
+    while (!this->limbs.empty() && this->limbs.back() == 0) this->limbs.pop_back();
+};
+
+bool BigCount::isZero() const
+{
+    return this->limbs.empty();
+};
+
+BigCount& BigCount::operator+=(const BigCount& other)
+{
+    if (this->limbs.size() < other.limbs.size()) this->limbs.resize(other.limbs.size(), 0);
+
+    unsigned int carry = 0;
+
+    for (int i = 0;i<this->limbs.size();i++) {
+        if (i >= other.limbs.size() && carry == 0) break;
+
+        unsigned long long limb = (unsigned long long) this->limbs[i] + (i < other.limbs.size() ? other.limbs[i] : 0) + carry;
+
+        this->limbs[i] = limb % base;
+        carry = limb / base;
+    }
+
+    if (carry != 0) this->limbs.push_back(carry);
+
+    return *this;
+};
+
+BigCount& BigCount::operator-=(const BigCount& other)
+{
+    if (*this < other) throw std::runtime_error("BigCount operator-=: result would be negative");
+
+    unsigned int borrow = 0;
+
+    for (int i = 0;i<this->limbs.size();i++) {
+        if (i >= other.limbs.size() && borrow == 0) break;
+
+        long long limb = (long long) this->limbs[i] - (i < other.limbs.size() ? other.limbs[i] : 0) - borrow;
+
+        borrow = limb < 0;
+        this->limbs[i] = limb < 0 ? limb + base : limb;
+    }
+
+    this->trim();
+
+    return *this;
+};
+
+bool BigCount::operator<(const BigCount& other) const
+{
+    if (this->limbs.size() != other.limbs.size()) return this->limbs.size() < other.limbs.size();
+
+    for (int i = this->limbs.size() - 1;i>=0;i--) {
+        if (this->limbs[i] != other.limbs[i]) return this->limbs[i] < other.limbs[i];
+    }
+
+    return false;
+};
+
+BigCount BigCount::uniformBelow(const BigCount& bound, std::mt19937_64& rng)
+{
+    if (bound.isZero()) throw std::runtime_error("BigCount uniformBelow: bound must be positive");
+
+    // uniform over every value with the same limb count and a top limb no larger than the bound's, then rejected until below the bound
+    // the top limb of the bound is at least 1, so at least half of the candidates are kept
+
+    std::uniform_int_distribution<unsigned int> limbDistribution(0, base - 1);
+    std::uniform_int_distribution<unsigned int> topLimbDistribution(0, bound.limbs.back());
+
+    while (true) {
+        BigCount sample;
+
+        sample.limbs.resize(bound.limbs.size());
+
+        for (int i = 0;i + 1<sample.limbs.size();i++) sample.limbs[i] = limbDistribution(rng);
+
+        sample.limbs.back() = topLimbDistribution(rng);
+
+        sample.trim();
+
+        if (sample < bound) return sample;
+    }
+};
+
+std::string BigCount::toString() const
+{
+    if (this->isZero()) return "0";
+
+    std::string output = std::to_string(this->limbs.back());
+
+    for (int i = this->limbs.size() - 2;i>=0;i--) {
+        auto limb = std::to_string(this->limbs[i]);
+
+        output += std::string(9 - limb.size(), '0') + limb;
+    }
+
+    return output;
+};
@@ -0,0 +1,41 @@
+#ifndef BIG_COUNT_HPP
+#define BIG_COUNT_HPP
+
+#include <string>
+#include <vector>
+#include <random>
+
+// unsigned integer of any size, word counts outgrow every machine integer (and lose the small terms in a double) within a few dozen letters
+// only what counting and sampling words needs, addition, subtraction of a count no larger, comparison and uniform sampling
+class BigCount
+{
+    private:
+        static constexpr unsigned int base = 1000000000;
+
+        // base 1e9 limbs, least significant first, never a leading zero limb so zero has none
+        std::vector<unsigned int> limbs;
+
+        void trim();
+
+    public:
+        BigCount() = default;
+        BigCount(unsigned int value);
+
+        bool isZero() const;
+
+        BigCount& operator+=(const BigCount& other);
+
+        // other must not be larger than this
+        BigCount& operator-=(const BigCount& other);
+
+        bool operator<(const BigCount& other) const;
+        bool operator==(const BigCount& other) const = default;
+
+        // uniform in [0, bound), bound must not be zero
+        static BigCount uniformBelow(const BigCount& bound, std::mt19937_64& rng);
+
+        // decimal
+        std::string toString() const;
+};
+
+#endif
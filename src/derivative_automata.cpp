@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <queue>
+
+#include "derivative_automata.hpp"
+
+// derivative term hash
+
+size_t std::hash<DerivativeTerm>::operator()(const DerivativeTerm& term) const
+{
+    size_t hash = (size_t) term.type * 257 + (unsigned char) term.letter;
+
+    for (auto operand : term.operands) hash = hash * 1000003 ^ operand;
+
+    return hash;
+};
+
+// derivative automata
+
+DerivativeAutomata::DerivativeAutomata(RegularExpression re)
+{
+    this->startTerm = this->fromRe(re);
+
+    std::sort(this->alphabet.begin(), this->alphabet.end());
+    this->alphabet.erase(std::unique(this->alphabet.begin(), this->alphabet.end()), this->alphabet.end());
+};
+
+int DerivativeAutomata::intern(DerivativeTerm term)
+{
+    auto existingTerm = this->termIndexes.find(term);
+
+    if (existingTerm != this->termIndexes.end()) return existingTerm->second;
+
+    bool nullable;
+
+    if (term.type == DerivativeTermType::NOTHING || term.type == DerivativeTermType::LETTER) nullable = false;
+    else if (term.type == DerivativeTermType::LAMBDA || term.type == DerivativeTermType::REPEAT) nullable = true;
+    else if (term.type == DerivativeTermType::SEQUENCE) nullable = std::all_of(term.operands.begin(), term.operands.end(), [this] (int operand) { return this->nullableTerms[operand]; });
+    else nullable = std::any_of(term.operands.begin(), term.operands.end(), [this] (int operand) { return this->nullableTerms[operand]; });
+
+    int termIndex = this->terms.size();
+
+    this->terms.push_back(term);
+    this->nullableTerms.push_back(nullable);
+    this->termIndexes[term] = termIndex;
+
+    return termIndex;
+};
+
+int DerivativeAutomata::nothing()
+{
+    return this->intern({ DerivativeTermType::NOTHING, '\0', {} });
+};
+
+int DerivativeAutomata::lambda()
+{
+    return this->intern({ DerivativeTermType::LAMBDA, '\0', {} });
+};
+
+int DerivativeAutomata::letter(char c)
+{
+    return this->intern({ DerivativeTermType::LETTER, c, {} });
+};
+
+int DerivativeAutomata::sequence(int term1, int term2)
+{
+    return this->sequence(std::vector<int>({ term1, term2 }));
+};
+
+int DerivativeAutomata::sequence(std::vector<int> sequenceTerms)
+{
+    // sequences are kept right nested so (ab)c and a(bc) intern to the same term, and so a suffix of a sequence is itself a term
+    // every term but the last is split into the operands along its spine, the last one already is right nested
+    std::vector<int> flatTerms;
+
+    for (int i = 0;i<sequenceTerms.size();i++) {
+        int sequenceTerm = sequenceTerms[i];
+
+        while (i != sequenceTerms.size() - 1 && this->terms[sequenceTerm].type == DerivativeTermType::SEQUENCE) {
+            flatTerms.push_back(this->terms[sequenceTerm].operands[0]);
+
+            sequenceTerm = this->terms[sequenceTerm].operands[1];
+        }
+
+        auto type = this->terms[sequenceTerm].type;
+
+        if (type == DerivativeTermType::NOTHING) return this->nothing();
+
+        if (type != DerivativeTermType::LAMBDA) flatTerms.push_back(sequenceTerm);
+    }
+
+    if (flatTerms.empty()) return this->lambda();
+
+    int term = flatTerms.back();
+
+    for (int i = flatTerms.size() - 2;i>=0;i--) term = this->intern({ DerivativeTermType::SEQUENCE, '\0', { flatTerms[i], term } });
+
+    return term;
+};
+
+int DerivativeAutomata::unite(std::vector<int> unionTerms)
+{
+    // flatten nested unions and drop nothing, then sort and dedupe so the union is associative, commutative and idempotent
+    std::vector<int> flatTerms;
+
+    for (auto unionTerm : unionTerms) {
+        auto& term = this->terms[unionTerm];
+
+        if (term.type == DerivativeTermType::NOTHING) continue;
+
+        if (term.type == DerivativeTermType::UNION) flatTerms.insert(flatTerms.end(), term.operands.begin(), term.operands.end());
+        else flatTerms.push_back(unionTerm);
+    }
+
+    std::sort(flatTerms.begin(), flatTerms.end());
+    flatTerms.erase(std::unique(flatTerms.begin(), flatTerms.end()), flatTerms.end());
+
+    if (flatTerms.empty()) return this->nothing();
+
+    if (flatTerms.size() == 1) return flatTerms[0];
+
+    return this->intern({ DerivativeTermType::UNION, '\0', flatTerms });
+};
+
+int DerivativeAutomata::repeat(int term)
+{
+    auto type = this->terms[term].type;
+
+    if (type == DerivativeTermType::NOTHING || type == DerivativeTermType::LAMBDA) return this->lambda();
+
+    if (type == DerivativeTermType::REPEAT) return term;
+
+    return this->intern({ DerivativeTermType::REPEAT, '\0', { term } });
+};
+
+int DerivativeAutomata::fromRe(RegularExpression re)
+{
+    std::vector<int> resultStack;
+
+    // expressions are dags, so shared sub expressions are only converted once
+    std::unordered_map<RegularExpression, int> convertedTerms;
+
+    // a whole chain of concats (or pluses) becomes one n ary term, so long chains are not re flattened once per link
+    auto getChainOperands = [] (RegularExpression re) {
+        std::vector<RegularExpression> operands;
+
+        std::vector<RegularExpression> stack = { re };
+
+        while (!stack.empty()) {
+            auto currentRe = stack.back();
+
+            stack.pop_back();
+
+            if (currentRe.getType() != re.getType()) {
+                operands.push_back(currentRe);
+
+                continue;
+            }
+
+            auto [re1, re2] = currentRe.getType() == CONCAT ? currentRe.getConcatExpression() : currentRe.getPlusExpression();
+
+            stack.push_back(re2);
+            stack.push_back(re1);
+        }
+
+        return operands;
+    };
+
+    // post order traversal, [re, children already visited]
+    std::vector<std::pair<RegularExpression, bool>> traversalStack = { { re, false } };
+
+    while (!traversalStack.empty()) {
+        auto [currentRe, isExpanded] = traversalStack.back();
+
+        traversalStack.pop_back();
+
+        auto type = currentRe.getType();
+
+        if (!isExpanded && convertedTerms.contains(currentRe)) resultStack.push_back(convertedTerms[currentRe]);
+
+        else if (type == EMPTY) resultStack.push_back(this->lambda());
+
+        else if (type == CHARACTER) {
+            this->alphabet.push_back(currentRe.getCharacterExpression());
+
+            resultStack.push_back(this->letter(currentRe.getCharacterExpression()));
+        }
+
+        else if (!isExpanded) {
+            traversalStack.push_back({ currentRe, true });
+
+            if (type == STAR) traversalStack.push_back({ currentRe.getStarExpression(), false });
+
+            else {
+                auto operands = getChainOperands(currentRe);
+
+                for (int i = operands.size() - 1;i>=0;i--) traversalStack.push_back({ operands[i], false });
+            }
+        }
+
+        else {
+            if (type == STAR) resultStack.back() = this->repeat(resultStack.back());
+
+            else {
+                int operandCount = getChainOperands(currentRe).size();
+
+                std::vector<int> operandTerms(resultStack.end() - operandCount, resultStack.end());
+                resultStack.resize(resultStack.size() - operandCount);
+
+                resultStack.push_back(type == CONCAT ? this->sequence(operandTerms) : this->unite(operandTerms));
+            }
+
+            convertedTerms[currentRe] = resultStack.back();
+        }
+    }
+
+    return resultStack.back();
+};
+
+int DerivativeAutomata::derive(int term, char c)
+{
+    auto cacheKey = [c] (int term) { return (long long) term * 256 + (unsigned char) c; };
+
+    // post order over the operands whose derivatives are needed, [term, operands already derived]
+    std::vector<std::pair<int, bool>> traversalStack = { { term, false } };
+
+    while (!traversalStack.empty()) {
+        auto [currentTermIndex, isExpanded] = traversalStack.back();
+
+        traversalStack.pop_back();
+
+        if (this->derivativeCache.contains(cacheKey(currentTermIndex))) continue;
+
+        // copy since interning below can reallocate this->terms
+        auto currentTerm = this->terms[currentTermIndex];
+
+        // d(rs) needs d(r), and d(s) as well when r is nullable
+        int derivedOperandCount = currentTerm.operands.size();
+
+        if (currentTerm.type == DerivativeTermType::SEQUENCE) {
+            derivedOperandCount = 0;
+
+            while (derivedOperandCount < currentTerm.operands.size() && this->nullableTerms[currentTerm.operands[derivedOperandCount++]]);
+        }
+
+        if (!isExpanded && derivedOperandCount > 0) {
+            traversalStack.push_back({ currentTermIndex, true });
+
+            for (int i = derivedOperandCount - 1;i>=0;i--) traversalStack.push_back({ currentTerm.operands[i], false });
+
+            continue;
+        }
+
+        auto getDerivative = [this, &cacheKey] (int operand) { return this->derivativeCache[cacheKey(operand)]; };
+
+        int derivative;
+
+        if (currentTerm.type == DerivativeTermType::NOTHING || currentTerm.type == DerivativeTermType::LAMBDA) derivative = this->nothing();
+
+        else if (currentTerm.type == DerivativeTermType::LETTER) derivative = currentTerm.letter == c ? this->lambda() : this->nothing();
+
+        else if (currentTerm.type == DerivativeTermType::UNION) {
+            std::vector<int> operandDerivatives;
+
+            for (auto operand : currentTerm.operands) operandDerivatives.push_back(getDerivative(operand));
+
+            derivative = this->unite(operandDerivatives);
+        }
+
+        // d(rs) = d(r)s + d(s) if r is nullable
+        else if (currentTerm.type == DerivativeTermType::SEQUENCE) {
+            std::vector<int> operandDerivatives;
+
+            for (int i = 0;i<derivedOperandCount;i++) {
+                std::vector<int> sequenceTerms = { getDerivative(currentTerm.operands[i]) };
+
+                sequenceTerms.insert(sequenceTerms.end(), currentTerm.operands.begin() + i + 1, currentTerm.operands.end());
+
+                operandDerivatives.push_back(this->sequence(sequenceTerms));
+            }
+
+            derivative = this->unite(operandDerivatives);
+        }
+
+        // d(r*) = d(r)r*
+        else derivative = this->sequence(getDerivative(currentTerm.operands[0]), currentTermIndex);
+
+        this->derivativeCache[cacheKey(currentTermIndex)] = derivative;
+    }
+
+    return this->derivativeCache[cacheKey(term)];
+};
+
+bool DerivativeAutomata::matches(std::string str)
+{
+    // lazy, only the derivatives along this one path are ever built (and then cached for later calls)
+    int term = this->startTerm;
+
+    for (auto c : str) {
+        term = this->derive(term, c);
+
+        if (this->terms[term].type == DerivativeTermType::NOTHING) return false;
+    }
+
+    return this->nullableTerms[term];
+};
+
+FiniteAutomata DerivativeAutomata::toDfa()
+{
+    // bfs over derivatives, each distinct canonical term is a dfa state
+    // the nothing term is the dead state and is left out, so the dfa is partial like every other dfa here
+
+    std::unordered_map<int, int> stateIndexes;
+    std::vector<int> stateTerms;
+    std::vector<std::tuple<int, int, char>> transitions;
+
+    std::queue<int> queue;
+
+    stateIndexes[this->startTerm] = 0;
+    stateTerms.push_back(this->startTerm);
+    queue.push(this->startTerm);
+
+    while (!queue.empty()) {
+        int term = queue.front();
+
+        queue.pop();
+
+        for (auto c : this->alphabet) {
+            int derivative = this->derive(term, c);
+
+            if (this->terms[derivative].type == DerivativeTermType::NOTHING) continue;
+
+            if (!stateIndexes.contains(derivative)) {
+                stateIndexes[derivative] = stateTerms.size();
+                stateTerms.push_back(derivative);
+                queue.push(derivative);
+            }
+
+            transitions.push_back({ stateIndexes[term], stateIndexes[derivative], c });
+        }
+    }
+
+    std::unordered_set<std::string> dfaStates;
+    std::unordered_set<std::string> dfaAcceptingStates;
+    std::unordered_set<Edge> dfaEdges;
+
+    for (int state = 0;state<stateTerms.size();state++) {
+        dfaStates.insert(std::to_string(state));
+
+        if (this->nullableTerms[stateTerms[state]]) dfaAcceptingStates.insert(std::to_string(state));
+    }
+
+    for (auto [startState, endState, c] : transitions) dfaEdges.insert(Edge(std::to_string(startState), std::to_string(endState), c));
+
+    return FiniteAutomata::create(dfaStates, "0", dfaAcceptingStates, dfaEdges);
+};
@@ -0,0 +1,74 @@
+#ifndef DERIVATIVE_AUTOMATA_HPP
+#define DERIVATIVE_AUTOMATA_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "regular_expression.hpp"
+#include "finite_automata.hpp"
+
+enum class DerivativeTermType
+{
+    NOTHING, // matches no string at all, derivatives need this where RegularExpression does not
+    LAMBDA,
+    LETTER,
+    SEQUENCE,
+    UNION,
+    REPEAT
+};
+
+// a node of a similarity normalized expression, operands are indexes of other interned terms
+class DerivativeTerm
+{
+    public:
+        DerivativeTermType type;
+        char letter;
+        std::vector<int> operands;
+
+        bool operator==(const DerivativeTerm&) const = default;
+};
+
+template <>
+struct std::hash<DerivativeTerm> {
+    size_t operator()(const DerivativeTerm& term) const;
+};
+
+class DerivativeAutomata
+{
+    private:
+        // hash consed terms, structurally equal terms always get the same index so state identity is an int compare
+        std::vector<DerivativeTerm> terms;
+        std::vector<bool> nullableTerms;
+        std::unordered_map<DerivativeTerm, int> termIndexes;
+
+        // [term * 256 + letter] = derivative term
+        std::unordered_map<long long, int> derivativeCache;
+
+        std::vector<char> alphabet;
+        int startTerm;
+
+        int intern(DerivativeTerm term);
+
+        // these apply the similarity rules while building, so every interned term is already canonical
+        int nothing();
+        int lambda();
+        int letter(char c);
+        int sequence(int term1, int term2);
+        int sequence(std::vector<int> sequenceTerms);
+        int unite(std::vector<int> unionTerms);
+        int repeat(int term);
+
+        int fromRe(RegularExpression re);
+
+        int derive(int term, char c);
+
+    public:
+        DerivativeAutomata(RegularExpression re);
+
+        bool matches(std::string str);
+
+        FiniteAutomata toDfa();
+};
+
+#endif
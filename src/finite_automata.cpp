@@ -1,12 +1,18 @@
 #include <stdexcept>
 #include <vector>
 #include <queue>
+#include <set>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <cstdlib>
 #include <filesystem>
+#include <iterator>
 
 #include "finite_automata.hpp"
+#include "derivative_automata.hpp"
+#include "indexed_automata.hpp"
+#include "big_count.hpp"
 
 // utils
 
@@ -24,6 +30,31 @@ std::string concatStrSet(std::unordered_set<std::string> strSet, std::string del
     return concat;
 };
 
+// edges ordered by start state, then letter (λ after every letter), then end state, the order their printed forms sort in
+std::vector<const Edge*> sortedEdgesOf(const std::unordered_set<Edge>& edges)
+{
+    std::vector<const Edge*> sortedEdges;
+    sortedEdges.reserve(edges.size());
+
+    for (auto& edge : edges) sortedEdges.push_back(&edge);
+
+    auto getLetterKey = [] (const Letter& letter) { return letter.has_value() ? (int) (unsigned char) letter.value() : 256; };
+
+    std::sort(sortedEdges.begin(), sortedEdges.end(), [&getLetterKey] (const Edge* edge1, const Edge* edge2) {
+        return std::tuple(std::string_view(edge1->start), getLetterKey(edge1->letter), std::string_view(edge1->end)) < std::tuple(std::string_view(edge2->start), getLetterKey(edge2->letter), std::string_view(edge2->end));
+    });
+
+    return sortedEdges;
+};
+
+// names the i-th of stateCount states, single letters when they fit and numbers otherwise
+std::string compressedStateName(int index, int stateCount)
+{
+    std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    return stateCount > alphabet.size() ? std::to_string(index) : std::string(1, alphabet[index]);
+};
+
 // transition class hash (see FiniteAutomata::getMinDfaEquivalenceClassIndexes)
 
 size_t std::hash<std::unordered_map<Letter, int>>::operator()(const std::unordered_map<Letter, int>& transitionClass) const
@@ -35,11 +66,33 @@ size_t std::hash<std::unordered_map<Letter, int>>::operator()(const std::unorder
     return hash;
 };
 
+// language fingerprint hash
+
+size_t std::hash<LanguageFingerprint>::operator()(const LanguageFingerprint& fingerprint) const
+{
+    // the fingerprint is already well mixed
+    return fingerprint.low;
+};
+
 // edge
 
 std::string Edge::toString()
 {
-    return "From " + this->start + " via " + (this->letter.has_value() ? std::string(1, this->letter.value()) : "λ") + " to " + this->end;
+    std::ostringstream output;
+
+    this->toString(output);
+
+    return output.str();
+};
+
+void Edge::toString(std::ostream& output) const
+{
+    output << "From " << this->start << " via ";
+
+    if (this->letter.has_value()) output << this->letter.value();
+    else output << "λ";
+
+    output << " to " << this->end;
 };
 
 size_t std::hash<Edge>::operator()(const Edge& edge) const
@@ -88,10 +141,8 @@ FiniteAutomata FiniteAutomata::compressNames()
     std::vector<std::string> originalStates(this->states.begin(), this->states.end());
     std::sort(originalStates.begin(), originalStates.end());
 
-    std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-
     std::unordered_map<std::string, std::string> compressionMap;
-    for (int i = 0;i<originalStates.size();i++) compressionMap[originalStates[i]] = originalStates.size() > alphabet.size() ? std::to_string(i) : std::string(1, alphabet[i]);
+    for (int i = 0;i<originalStates.size();i++) compressionMap[originalStates[i]] = compressedStateName(i, originalStates.size());
 
     std::unordered_set<std::string> compressedStates;
     for (auto originalState : this->states) compressedStates.insert(compressionMap[originalState]);
@@ -125,102 +176,261 @@ bool FiniteAutomata::isDeterministic()
     return true;
 };
 
-std::string FiniteAutomata::addRe(std::string startState, RegularExpression re)
+int FiniteAutomata::ThompsonBuilder::allocateState()
+{
+    return this->stateCount++;
+};
+
+void FiniteAutomata::ThompsonBuilder::addRe(int startState, int endState, RegularExpression re)
 {
     auto type = re.getType();
 
-    if (type == EMPTY) return this->addEmptyRe(startState);
+    if (type == EMPTY) this->addEmptyRe(startState, endState);
     
-    else if (type == CHARACTER) return this->addCharacterRe(startState, re.getCharacterExpression());
+    else if (type == CHARACTER) this->addCharacterRe(startState, endState, re.getCharacterExpression());
     
     else if (type == CONCAT) {
         auto [re1, re2] = re.getConcatExpression();
 
-        return this->addConcatRe(startState, *re1, *re2);
+        this->addConcatRe(startState, endState, re1, re2);
     }
 
     else if (type == PLUS) {
         auto [re1, re2] = re.getPlusExpression();
 
-        return this->addPlusRe(startState, *re1, *re2);
+        this->addPlusRe(startState, endState, re1, re2);
     }
 
-    else return this->addStarRe(startState, *re.getStarExpression());
+    else this->addStarRe(startState, endState, re.getStarExpression());
 };
 
-std::string FiniteAutomata::addEmptyRe(std::string startState)
-{
-    std::string nextState = startState + "-c";
+// every add*Re keeps the invariant that it never adds an edge into its start state or out of its end state (unless they are the same state)
+// that is what lets plus branches share their endpoints and concat halves share a middle state without leaking paths between each other
 
-    this->states.insert(nextState);
-    
-    this->edges.insert(Edge(startState, nextState, {}));
+void FiniteAutomata::ThompsonBuilder::addEmptyRe(int startState, int endState)
+{
+    this->edges.push_back({ startState, endState, {} });
+};
 
-    return nextState;
+void FiniteAutomata::ThompsonBuilder::addCharacterRe(int startState, int endState, char characterExpression)
+{
+    this->edges.push_back({ startState, endState, characterExpression });
 };
 
-std::string FiniteAutomata::addCharacterRe(std::string startState, char characterExpression)
+void FiniteAutomata::ThompsonBuilder::addConcatRe(int startState, int endState, RegularExpression re1, RegularExpression re2)
 {
-    std::string nextState = startState + "-c";
+    int middleState = this->allocateState();
 
-    this->states.insert(nextState);
-    
-    this->edges.insert(Edge(startState, nextState, characterExpression));
+    this->pendingRes.push_back({ startState, middleState, re1 });
+    this->pendingRes.push_back({ middleState, endState, re2 });
+};
 
-    return nextState;
+void FiniteAutomata::ThompsonBuilder::addPlusRe(int startState, int endState, RegularExpression re1, RegularExpression re2)
+{
+    this->pendingRes.push_back({ startState, endState, re1 });
+    this->pendingRes.push_back({ startState, endState, re2 });
 };
 
-std::string FiniteAutomata::addConcatRe(std::string startState, RegularExpression re1, RegularExpression re2)
+void FiniteAutomata::ThompsonBuilder::addStarRe(int startState, int endState, RegularExpression re)
 {
-    std::string nextState = this->addRe(startState, re1);
-    std::string nextNextState = this->addRe(nextState, re2);
+    // the loop gets its own state so repeating the re can never re-enter whatever precedes the star or continue from whatever follows it
+    int loopState = this->allocateState();
 
-    return nextNextState;
+    this->edges.push_back({ startState, loopState, {} });
+    this->edges.push_back({ loopState, endState, {} });
+
+    this->pendingRes.push_back({ loopState, loopState, re });
 };
 
-std::string FiniteAutomata::addPlusRe(std::string startState, RegularExpression re1, RegularExpression re2)
+FiniteAutomata FiniteAutomata::ThompsonBuilder::build(RegularExpression re)
 {
-    std::string branchStartState1 = startState + "-b0";
-    std::string branchStartState2 = startState + "-b1";
-    
-    this->states.insert(branchStartState1);
-    this->states.insert(branchStartState2);
+    // size the state counter and edge vector up front so nothing is reallocated while building
+    int expectedEdgeCount = 0;
 
-    this->edges.insert(Edge(startState, branchStartState1, {}));
-    this->edges.insert(Edge(startState, branchStartState2, {}));
+    std::vector<RegularExpression> sizingStack = { re };
 
-    std::string branchEndState1 = this->addRe(branchStartState1, re1);
-    std::string branchEndState2 = this->addRe(branchStartState2, re2);
+    while (!sizingStack.empty()) {
+        auto currentRe = sizingStack.back();
 
-    std::string branchCombineState = startState + "-c";
+        sizingStack.pop_back();
 
-    this->states.insert(branchCombineState);
+        auto type = currentRe.getType();
 
-    this->edges.insert(Edge(branchEndState1, branchCombineState, {}));
-    this->edges.insert(Edge(branchEndState2, branchCombineState, {}));
+        if (type == EMPTY || type == CHARACTER) expectedEdgeCount += 1;
 
-    return branchCombineState;
-};
+        else if (type == CONCAT) {
+            auto [re1, re2] = currentRe.getConcatExpression();
 
-std::string FiniteAutomata::addStarRe(std::string startState, RegularExpression re)
-{
-    std::string nextState = this->addRe(startState, re);
+            sizingStack.push_back(re1);
+            sizingStack.push_back(re2);
+        }
+
+        else if (type == PLUS) {
+            auto [re1, re2] = currentRe.getPlusExpression();
+
+            sizingStack.push_back(re1);
+            sizingStack.push_back(re2);
+        }
+
+        else {
+            expectedEdgeCount += 2;
+
+            sizingStack.push_back(currentRe.getStarExpression());
+        }
+    }
 
-    this->edges.insert(Edge(startState, nextState, {}));
-    this->edges.insert(Edge(nextState, startState, {}));
+    this->edges.reserve(expectedEdgeCount);
 
-    return nextState;
+    int startState = this->allocateState();
+    int acceptingState = this->allocateState();
+
+    this->pendingRes.push_back({ startState, acceptingState, re });
+
+    while (!this->pendingRes.empty()) {
+        auto [pendingStartState, pendingEndState, pendingRe] = this->pendingRes.back();
+
+        this->pendingRes.pop_back();
+
+        this->addRe(pendingStartState, pendingEndState, pendingRe);
+    }
+
+    std::vector<std::string> stateNames;
+    stateNames.reserve(this->stateCount);
+    for (int state = 0;state<this->stateCount;state++) stateNames.push_back(compressedStateName(state, this->stateCount));
+
+    std::unordered_set<std::string> lnfaStates(stateNames.begin(), stateNames.end());
+
+    std::unordered_set<Edge> lnfaEdges;
+    lnfaEdges.reserve(this->edges.size());
+    for (auto [edgeStartState, edgeEndState, letter] : this->edges) lnfaEdges.insert(Edge(stateNames[edgeStartState], stateNames[edgeEndState], letter));
+
+    return FiniteAutomata(lnfaStates, stateNames[startState], { stateNames[acceptingState] }, lnfaEdges);
 };
 
 FiniteAutomata FiniteAutomata::re2lnfa(RegularExpression re)
 {
-    FiniteAutomata lnfa = FiniteAutomata({ "START" }, "START", {}, {});
+    return FiniteAutomata::re2lnfa(re, false);
+};
 
-    std::string lnfaAcceptingState = lnfa.addRe("START", re);
-    
-    lnfa.acceptingStates.insert(lnfaAcceptingState);
+FiniteAutomata FiniteAutomata::re2lnfa(RegularExpression re, bool shouldSimplify)
+{
+    // a smaller expression directly means fewer states and lambda edges
+    return ThompsonBuilder().build(shouldSimplify ? re.simplify() : re);
+};
+
+FiniteAutomata FiniteAutomata::re2nfa(RegularExpression re)
+{
+    // glushkov construction: one state per character occurrence ("position") plus the start state, no lambda edges
+    // an edge into position p is always labeled with p's character, so all that is needed is which positions can follow which
+
+    struct PositionSets
+    {
+        bool nullable;
+        std::vector<int> first;
+        std::vector<int> last;
+    };
 
-    return lnfa.compressNames();
+    std::vector<char> positionLetters = { '\0' }; // position 0 is the start state
+    std::vector<std::vector<int>> follow = { {} };
+
+    std::vector<PositionSets> resultStack;
+
+    // post order traversal, [re, children already visited]
+    // right children are pushed first so positions are numbered left to right
+    std::vector<std::pair<RegularExpression, bool>> traversalStack = { { re, false } };
+
+    while (!traversalStack.empty()) {
+        auto [currentRe, isExpanded] = traversalStack.back();
+
+        traversalStack.pop_back();
+
+        auto type = currentRe.getType();
+
+        if (type == EMPTY) resultStack.push_back({ true, {}, {} });
+
+        else if (type == CHARACTER) {
+            int position = positionLetters.size();
+
+            positionLetters.push_back(currentRe.getCharacterExpression());
+            follow.push_back({});
+
+            resultStack.push_back({ false, { position }, { position } });
+        }
+
+        else if (!isExpanded) {
+            traversalStack.push_back({ currentRe, true });
+
+            if (type == STAR) traversalStack.push_back({ currentRe.getStarExpression(), false });
+
+            else {
+                auto [re1, re2] = type == CONCAT ? currentRe.getConcatExpression() : currentRe.getPlusExpression();
+
+                traversalStack.push_back({ re2, false });
+                traversalStack.push_back({ re1, false });
+            }
+        }
+
+        else if (type == STAR) {
+            auto& sets = resultStack.back();
+
+            for (auto lastPosition : sets.last) follow[lastPosition].insert(follow[lastPosition].end(), sets.first.begin(), sets.first.end());
+
+            sets.nullable = true;
+        }
+
+        else {
+            auto sets2 = std::move(resultStack.back());
+            resultStack.pop_back();
+
+            auto& sets1 = resultStack.back();
+
+            if (type == PLUS) {
+                sets1.nullable = sets1.nullable || sets2.nullable;
+                sets1.first.insert(sets1.first.end(), sets2.first.begin(), sets2.first.end());
+                sets1.last.insert(sets1.last.end(), sets2.last.begin(), sets2.last.end());
+            }
+            else {
+                for (auto lastPosition : sets1.last) follow[lastPosition].insert(follow[lastPosition].end(), sets2.first.begin(), sets2.first.end());
+
+                if (sets1.nullable) sets1.first.insert(sets1.first.end(), sets2.first.begin(), sets2.first.end());
+
+                if (sets2.nullable) sets1.last.insert(sets1.last.end(), sets2.last.begin(), sets2.last.end());
+                else sets1.last = std::move(sets2.last);
+
+                sets1.nullable = sets1.nullable && sets2.nullable;
+            }
+        }
+    }
+
+    auto rootSets = resultStack.back();
+
+    // the start state behaves like a position whose followers are the first positions
+    follow[0] = rootSets.first;
+
+    int stateCount = positionLetters.size();
+
+    std::vector<std::string> stateNames;
+    stateNames.reserve(stateCount);
+    for (int state = 0;state<stateCount;state++) stateNames.push_back(compressedStateName(state, stateCount));
+
+    std::unordered_set<std::string> nfaStates(stateNames.begin(), stateNames.end());
+
+    std::unordered_set<std::string> nfaAcceptingStates;
+    for (auto lastPosition : rootSets.last) nfaAcceptingStates.insert(stateNames[lastPosition]);
+    if (rootSets.nullable) nfaAcceptingStates.insert(stateNames[0]);
+
+    std::unordered_set<Edge> nfaEdges;
+    for (int position = 0;position<stateCount;position++) {
+        for (auto followingPosition : follow[position]) nfaEdges.insert(Edge(stateNames[position], stateNames[followingPosition], positionLetters[followingPosition]));
+    }
+
+    return FiniteAutomata(nfaStates, stateNames[0], nfaAcceptingStates, nfaEdges);
+};
+
+FiniteAutomata FiniteAutomata::re2dfa(RegularExpression re)
+{
+    // brzozowski construction, see DerivativeAutomata (which can also be used directly as a lazy matcher)
+    return DerivativeAutomata(re).toDfa();
 };
 
 FiniteAutomata FiniteAutomata::lnfa2renfa()
@@ -245,6 +455,21 @@ FiniteAutomata FiniteAutomata::lnfa2renfa()
 };
 
 RegularExpression FiniteAutomata::lnfa2re()
+{
+    return this->lnfa2re(ARBITRARY);
+};
+
+RegularExpression FiniteAutomata::lnfa2re(StateEliminationOrdering ordering)
+{
+    return this->lnfa2re(ordering, RegularExpressionContext::global());
+};
+
+RegularExpression FiniteAutomata::lnfa2re(StateEliminationOrdering ordering, RegularExpressionContext& context)
+{
+    return this->lnfa2re(ordering, context, false);
+};
+
+RegularExpression FiniteAutomata::lnfa2re(StateEliminationOrdering ordering, RegularExpressionContext& context, bool shouldSimplify)
 {
     auto renfa = this->lnfa2renfa();
 
@@ -255,7 +480,7 @@ RegularExpression FiniteAutomata::lnfa2re()
     std::unordered_map<std::string, std::unordered_map<std::string, RegularExpression>> reInvertedTransitionTable;
 
     for (auto edge : renfa.edges) {
-        auto edgeRe = edge.letter.has_value() ? RegularExpression::character(edge.letter.value()) : RegularExpression::empty();
+        auto edgeRe = edge.letter.has_value() ? RegularExpression::character(context, edge.letter.value()) : RegularExpression::empty(context);
 
         // combine parallel edges with plus
         auto updatedTransitionRe = reTransitionTable[edge.start].contains(edge.end) ? RegularExpression::plus(reTransitionTable[edge.start][edge.end], edgeRe) : edgeRe;
@@ -270,10 +495,76 @@ RegularExpression FiniteAutomata::lnfa2re()
     internalStates.erase(renfa.startState);
     internalStates.erase(*renfa.acceptingStates.begin());
 
+    // the size of the result depends heavily on the order states are spliced out, so each ordering ranks states by a cost of splicing them now
+
+    // every in-edge gets joined with every out-edge, so in degree x out degree is the number of edges splicing creates
+    auto getDegreeProduct = [&] (std::string state) -> size_t {
+        size_t inDegree = reInvertedTransitionTable[state].size() - reInvertedTransitionTable[state].contains(state);
+        size_t outDegree = reTransitionTable[state].size() - reTransitionTable[state].contains(state);
+
+        return inDegree * outDegree;
+    };
+
+    // total expression size splicing adds: each in-edge re is copied once per extra out-edge, each out-edge re once per extra in-edge, and the self loop once per extra joined pair
+    auto getWeight = [&] (std::string state) -> size_t {
+        size_t inDegree = reInvertedTransitionTable[state].size() - reInvertedTransitionTable[state].contains(state);
+        size_t outDegree = reTransitionTable[state].size() - reTransitionTable[state].contains(state);
+
+        if (inDegree == 0 || outDegree == 0) return 0;
+
+        size_t weight = 0;
+
+        for (auto [neighborState, re] : reInvertedTransitionTable[state]) if (neighborState != state) weight += re.size() * (outDegree - 1);
+        for (auto [neighborState, re] : reTransitionTable[state]) if (neighborState != state) weight += re.size() * (inDegree - 1);
+
+        if (reTransitionTable[state].contains(state)) weight += reTransitionTable[state][state].size() * (inDegree * outDegree - 1);
+
+        return weight;
+    };
+
+    auto getCost = [&] (std::string state) -> size_t {
+        return ordering == MIN_DEGREE_PRODUCT ? getDegreeProduct(state) : getWeight(state);
+    };
+
+    std::vector<std::string> staticEliminationOrder(internalStates.begin(), internalStates.end());
+
+    if (ordering == MIN_WEIGHT) {
+        std::unordered_map<std::string, size_t> weights;
+        for (auto state : staticEliminationOrder) weights[state] = getWeight(state);
+
+        std::stable_sort(staticEliminationOrder.begin(), staticEliminationOrder.end(), [&] (std::string state1, std::string state2) {
+            return weights[state1] < weights[state2];
+        });
+    }
+
+    // dynamic orderings keep a priority set that is updated for the neighbors of each spliced state, since nothing else changes cost
+    bool isDynamic = ordering == MIN_DEGREE_PRODUCT || ordering == DYNAMIC_MIN_WEIGHT;
+
+    std::set<std::pair<size_t, std::string>> eliminationQueue;
+    std::unordered_map<std::string, size_t> eliminationCosts;
+
+    if (isDynamic) {
+        for (auto state : internalStates) {
+            eliminationCosts[state] = getCost(state);
+
+            eliminationQueue.insert({ eliminationCosts[state], state });
+        }
+    }
+
     // "splice out" each internal state and insert new edges for every combination of incoming and outgoing edges
-    for (auto internalState : internalStates) {
+    for (int eliminationIndex = 0;eliminationIndex<staticEliminationOrder.size();eliminationIndex++) {
+        std::string internalState;
+
+        if (isDynamic) {
+            internalState = eliminationQueue.begin()->second;
+
+            eliminationQueue.erase(eliminationQueue.begin());
+            eliminationCosts.erase(internalState);
+        }
+        else internalState = staticEliminationOrder[eliminationIndex];
+
         // if the state being spliced has a self edge, the regular expression for that edge is starred and placed between the left and right expressions being joined
-        auto selfLoopRe = reTransitionTable[internalState].contains(internalState) ? RegularExpression::star(reTransitionTable[internalState][internalState]) : RegularExpression::empty();
+        auto selfLoopRe = reTransitionTable[internalState].contains(internalState) ? RegularExpression::star(reTransitionTable[internalState][internalState]) : RegularExpression::empty(context);
 
         auto transitionsEndingAtInternalState = reInvertedTransitionTable[internalState];
         auto transitionsStartingAtInternalState = reTransitionTable[internalState];
@@ -300,9 +591,27 @@ RegularExpression FiniteAutomata::lnfa2re()
         reInvertedTransitionTable.erase(internalState);
         for (auto [stateEndingAtInternalState, _] : transitionsEndingAtInternalState) reTransitionTable[stateEndingAtInternalState].erase(internalState);
         for (auto [stateStartingAtInternalState, _] : transitionsStartingAtInternalState) reInvertedTransitionTable[stateStartingAtInternalState].erase(internalState);
+
+        if (!isDynamic) continue;
+
+        std::unordered_set<std::string> neighborStates;
+        for (auto [neighborState, _] : transitionsEndingAtInternalState) neighborStates.insert(neighborState);
+        for (auto [neighborState, _] : transitionsStartingAtInternalState) neighborStates.insert(neighborState);
+
+        for (auto neighborState : neighborStates) {
+            if (!eliminationCosts.contains(neighborState)) continue;
+
+            eliminationQueue.erase({ eliminationCosts[neighborState], neighborState });
+
+            eliminationCosts[neighborState] = getCost(neighborState);
+
+            eliminationQueue.insert({ eliminationCosts[neighborState], neighborState });
+        }
     }
 
-    return reTransitionTable[renfa.startState][*renfa.acceptingStates.begin()];
+    auto re = reTransitionTable[renfa.startState][*renfa.acceptingStates.begin()];
+
+    return shouldSimplify ? re.simplify() : re;
 };
 
 std::unordered_set<std::string> FiniteAutomata::getStatesDirectlyStartingAt(std::string state)
@@ -457,6 +766,205 @@ FiniteAutomata FiniteAutomata::lnfa2nfa()
     return FiniteAutomata(this->states, this->startState, nfaAcceptingStates, nfaEdges);
 };
 
+FiniteAutomata FiniteAutomata::lnfa2compactNfa()
+{
+    // same language as lnfa2nfa, but avoids the back closure x forward closure edge explosion:
+    //      states on a lambda cycle are interchangeable, so each lambda scc is merged into one state
+    //      only the start state and states entered by a lettered edge are kept, every other state is only ever "passed through" via lambda moves
+    //      kept states that are unreachable or cant reach an accepting state are dropped
+
+    std::vector<std::string> stateNames(this->states.begin(), this->states.end());
+    std::sort(stateNames.begin(), stateNames.end());
+
+    std::unordered_map<std::string, int> stateIndexes;
+    for (int i = 0;i<stateNames.size();i++) stateIndexes[stateNames[i]] = i;
+
+    int stateCount = stateNames.size();
+
+    std::vector<std::vector<int>> lambdaSuccessors(stateCount);
+    for (auto edge : this->edges) if (!edge.letter.has_value()) lambdaSuccessors[stateIndexes[edge.start]].push_back(stateIndexes[edge.end]);
+
+    // iterative tarjan over lambda edges, components are discovered sinks first
+    std::vector<int> componentIndexes(stateCount, -1);
+    std::vector<int> discoveryIndexes(stateCount, -1);
+    std::vector<int> lowLinks(stateCount, 0);
+    std::vector<bool> isOnStack(stateCount, false);
+    std::vector<int> tarjanStack;
+    int discoveryCount = 0;
+    int componentCount = 0;
+
+    for (int root = 0;root<stateCount;root++) {
+        if (discoveryIndexes[root] != -1) continue;
+
+        // [state, next successor to visit]
+        std::vector<std::pair<int, int>> callStack = { { root, 0 } };
+
+        while (!callStack.empty()) {
+            auto& [state, successorIndex] = callStack.back();
+
+            if (successorIndex == 0 && discoveryIndexes[state] == -1) {
+                discoveryIndexes[state] = lowLinks[state] = discoveryCount++;
+
+                tarjanStack.push_back(state);
+                isOnStack[state] = true;
+            }
+
+            if (successorIndex < lambdaSuccessors[state].size()) {
+                int successor = lambdaSuccessors[state][successorIndex++];
+
+                if (discoveryIndexes[successor] == -1) callStack.push_back({ successor, 0 });
+                else if (isOnStack[successor]) lowLinks[state] = std::min(lowLinks[state], discoveryIndexes[successor]);
+
+                continue;
+            }
+
+            if (lowLinks[state] == discoveryIndexes[state]) {
+                while (true) {
+                    int member = tarjanStack.back();
+
+                    tarjanStack.pop_back();
+                    isOnStack[member] = false;
+
+                    componentIndexes[member] = componentCount;
+
+                    if (member == state) break;
+                }
+
+                componentCount++;
+            }
+
+            int finishedState = state;
+
+            callStack.pop_back();
+
+            if (!callStack.empty()) lowLinks[callStack.back().first] = std::min(lowLinks[callStack.back().first], lowLinks[finishedState]);
+        }
+    }
+
+    // states are visited in sorted order, so the first member seen is the alphabetically smallest name in the component
+    std::vector<int> componentRepresentatives(componentCount, -1);
+    for (int state = 0;state<stateCount;state++) if (componentRepresentatives[componentIndexes[state]] == -1) componentRepresentatives[componentIndexes[state]] = state;
+
+    std::vector<bool> isComponentAccepting(componentCount, false);
+    for (auto acceptingState : this->acceptingStates) isComponentAccepting[componentIndexes[stateIndexes[acceptingState]]] = true;
+
+    std::vector<std::unordered_set<int>> componentLambdaSuccessors(componentCount);
+    std::vector<std::set<std::pair<int, Letter>>> componentLetterSuccessors(componentCount);
+    std::vector<bool> isKept(componentCount, false);
+
+    isKept[componentIndexes[stateIndexes[this->startState]]] = true;
+
+    for (auto edge : this->edges) {
+        int startComponent = componentIndexes[stateIndexes[edge.start]];
+        int endComponent = componentIndexes[stateIndexes[edge.end]];
+
+        if (!edge.letter.has_value()) {
+            if (startComponent != endComponent) componentLambdaSuccessors[startComponent].insert(endComponent);
+        }
+        else {
+            componentLetterSuccessors[startComponent].insert({ endComponent, edge.letter });
+
+            isKept[endComponent] = true;
+        }
+    }
+
+    // for each kept component, fold in the lettered edges and acceptance of everything in its forward lambda closure
+    std::vector<std::set<std::pair<int, Letter>>> compactSuccessors(componentCount);
+    std::vector<bool> isCompactAccepting(componentCount, false);
+
+    std::vector<int> visitedStamps(componentCount, -1);
+
+    for (int component = 0;component<componentCount;component++) {
+        if (!isKept[component]) continue;
+
+        std::vector<int> stack = { component };
+        visitedStamps[component] = component;
+
+        while (!stack.empty()) {
+            int closureComponent = stack.back();
+
+            stack.pop_back();
+
+            if (isComponentAccepting[closureComponent]) isCompactAccepting[component] = true;
+
+            compactSuccessors[component].insert(componentLetterSuccessors[closureComponent].begin(), componentLetterSuccessors[closureComponent].end());
+
+            for (auto successor : componentLambdaSuccessors[closureComponent]) {
+                if (visitedStamps[successor] == component) continue;
+
+                visitedStamps[successor] = component;
+                stack.push_back(successor);
+            }
+        }
+    }
+
+    // trim to states that are both reachable from the start and able to reach an accepting state
+
+    int startComponent = componentIndexes[stateIndexes[this->startState]];
+
+    std::vector<bool> isReachable(componentCount, false);
+    std::vector<int> stack = { startComponent };
+    isReachable[startComponent] = true;
+
+    std::vector<std::vector<int>> compactPredecessors(componentCount);
+
+    while (!stack.empty()) {
+        int component = stack.back();
+
+        stack.pop_back();
+
+        for (auto [successor, _] : compactSuccessors[component]) {
+            compactPredecessors[successor].push_back(component);
+
+            if (isReachable[successor]) continue;
+
+            isReachable[successor] = true;
+            stack.push_back(successor);
+        }
+    }
+
+    std::vector<bool> isProductive(componentCount, false);
+    for (int component = 0;component<componentCount;component++) {
+        if (isReachable[component] && isCompactAccepting[component]) {
+            isProductive[component] = true;
+            stack.push_back(component);
+        }
+    }
+
+    while (!stack.empty()) {
+        int component = stack.back();
+
+        stack.pop_back();
+
+        for (auto predecessor : compactPredecessors[component]) {
+            if (isProductive[predecessor]) continue;
+
+            isProductive[predecessor] = true;
+            stack.push_back(predecessor);
+        }
+    }
+
+    std::unordered_set<std::string> compactStates = { stateNames[componentRepresentatives[startComponent]] };
+    std::unordered_set<std::string> compactAcceptingStates;
+    std::unordered_set<Edge> compactEdges;
+
+    for (int component = 0;component<componentCount;component++) {
+        if (!isReachable[component] || !isProductive[component]) continue;
+
+        auto compactState = stateNames[componentRepresentatives[component]];
+
+        compactStates.insert(compactState);
+
+        if (isCompactAccepting[component]) compactAcceptingStates.insert(compactState);
+
+        for (auto [successor, letter] : compactSuccessors[component]) {
+            if (isProductive[successor]) compactEdges.insert(Edge(compactState, stateNames[componentRepresentatives[successor]], letter));
+        }
+    }
+
+    return FiniteAutomata(compactStates, stateNames[componentRepresentatives[startComponent]], compactAcceptingStates, compactEdges);
+};
+
 FiniteAutomata FiniteAutomata::nfa2dfa()
 {
     if (this->hasLambdaMoves()) throw std::runtime_error("FiniteAutomata nfa2dfa: only callable for ordinary NFA");
@@ -514,8 +1022,15 @@ std::unordered_map<std::string, int> FiniteAutomata::getMinDfaEquivalenceClassIn
     std::unordered_map<std::string, int> equivalenceClassIndexes;
 
     // initial partition
-    int numEquivalenceClasses = 2;
-    for (auto state : reachableStates) equivalenceClassIndexes[state] = this->acceptingStates.contains(state);
+    std::unordered_set<int> initialEquivalenceClasses;
+    for (auto state : reachableStates) {
+        equivalenceClassIndexes[state] = this->acceptingStates.contains(state);
+
+        initialEquivalenceClasses.insert(equivalenceClassIndexes[state]);
+    }
+
+    // if every state is accepting (or none are) there is only one initial class, counting it as two would stop a real split into two classes
+    int numEquivalenceClasses = initialEquivalenceClasses.size();
 
     // continue partitioning until minimal equivalence classes are found
     while (true) {
@@ -628,40 +1143,550 @@ FiniteAutomata FiniteAutomata::dfa2complement()
     return FiniteAutomata(complementStates, this->startState, complementAcceptingStates, complementEdges);
 };
 
-bool FiniteAutomata::matches(std::string str)
+FiniteAutomata FiniteAutomata::product(FiniteAutomata fa1, FiniteAutomata fa2, ProductOperation operation, bool shouldMinimize)
 {
-    if (!this->isDeterministic()) throw std::runtime_error("FiniteAutomata matches: only callable for DFA");
+    // bfs over pairs of subset states, only pairs reachable from the start pair are ever built
 
-    std::string state = this->startState;
+    IndexedAutomata automata1(fa1);
+    IndexedAutomata automata2(fa2);
 
-    for (auto letter : str) {
-        auto transitionsAtState = this->transitionTable[state];
+    std::vector<char> alphabet;
+    std::set_union(automata1.alphabet.begin(), automata1.alphabet.end(), automata2.alphabet.begin(), automata2.alphabet.end(), std::back_inserter(alphabet));
 
-        if (!transitionsAtState.contains(letter)) return false;
+    auto isAcceptingPair = [operation] (bool isAccepting1, bool isAccepting2) {
+        if (operation == INTERSECT) return isAccepting1 && isAccepting2;
+        if (operation == UNITE) return isAccepting1 || isAccepting2;
+        if (operation == DIFFERENCE) return isAccepting1 && !isAccepting2;
 
-        state = *transitionsAtState[letter].begin();
-    }
+        return isAccepting1 != isAccepting2;
+    };
 
-    return this->acceptingStates.contains(state);
-};
+    // an empty subset is a dead side, pairs that can never accept because of a dead side are left out up front
+    auto isDeadPair = [operation] (const std::vector<int>& subset1, const std::vector<int>& subset2) {
+        if (operation == INTERSECT) return subset1.empty() || subset2.empty();
+        if (operation == DIFFERENCE) return subset1.empty();
 
-bool FiniteAutomata::isIsomorphism(FiniteAutomata dfa1, FiniteAutomata dfa2)
-{
-    if (!dfa1.isDeterministic() || !dfa2.isDeterministic()) throw std::runtime_error("FiniteAutomata isIsomorphism: only callable on DFAs");
+        return subset1.empty() && subset2.empty();
+    };
 
-    // run bfs on both dfa graphs and look for structural differences
+    std::unordered_map<std::vector<int>, int> subsetIds1;
+    std::unordered_map<std::vector<int>, int> subsetIds2;
 
-    std::unordered_set<std::string> visited1;
-    std::unordered_set<std::string> visited2;
+    // [subset id 1, subset id 2] packed into one key = product state index
+    std::unordered_map<long long, int> pairIndexes;
 
-    std::queue<std::string> queue1;
-    std::queue<std::string> queue2;
+    std::vector<std::pair<std::vector<int>, std::vector<int>>> pairs;
+    std::vector<bool> acceptingPairs;
+    std::vector<std::tuple<int, int, char>> transitions;
 
-    queue1.push(dfa1.startState);
-    queue2.push(dfa2.startState);
+    auto getPairIndex = [&] (const std::vector<int>& subset1, const std::vector<int>& subset2) {
+        long long subsetId1 = subsetIds1.try_emplace(subset1, subsetIds1.size()).first->second;
+        long long subsetId2 = subsetIds2.try_emplace(subset2, subsetIds2.size()).first->second;
 
-    while (!queue1.empty()) {
-        auto currentState1 = queue1.front();
+        auto [pairIndex, isInserted] = pairIndexes.try_emplace((subsetId1 << 32) | subsetId2, pairs.size());
+
+        if (isInserted) {
+            pairs.push_back({ subset1, subset2 });
+            acceptingPairs.push_back(isAcceptingPair(automata1.isAccepting(subset1), automata2.isAccepting(subset2)));
+        }
+
+        return pairIndex->second;
+    };
+
+    getPairIndex(automata1.getStartSubset(), automata2.getStartSubset());
+
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) {
+        // copy since adding pairs below can reallocate pairs
+        auto [subset1, subset2] = pairs[pairIndex];
+
+        for (auto c : alphabet) {
+            auto endSubset1 = automata1.step(subset1, c);
+            auto endSubset2 = automata2.step(subset2, c);
+
+            if (isDeadPair(endSubset1, endSubset2)) continue;
+
+            transitions.push_back({ pairIndex, getPairIndex(endSubset1, endSubset2), c });
+        }
+    }
+
+    // trim pairs that cannot reach an accepting pair, the start pair always stays
+
+    std::vector<std::vector<int>> reversedTransitions(pairs.size());
+    for (auto [startPair, endPair, _] : transitions) reversedTransitions[endPair].push_back(startPair);
+
+    std::vector<bool> productivePairs = acceptingPairs;
+    std::vector<int> stack;
+
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) if (productivePairs[pairIndex]) stack.push_back(pairIndex);
+
+    while (!stack.empty()) {
+        int pairIndex = stack.back();
+
+        stack.pop_back();
+
+        for (auto startPair : reversedTransitions[pairIndex]) {
+            if (productivePairs[startPair]) continue;
+
+            productivePairs[startPair] = true;
+            stack.push_back(startPair);
+        }
+    }
+
+    productivePairs[0] = true;
+
+    std::vector<int> stateIndexes(pairs.size(), -1);
+    int stateCount = 0;
+
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) if (productivePairs[pairIndex]) stateIndexes[pairIndex] = stateCount++;
+
+    std::unordered_set<std::string> productStates;
+    std::unordered_set<std::string> productAcceptingStates;
+    std::unordered_set<Edge> productEdges;
+
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) {
+        if (!productivePairs[pairIndex]) continue;
+
+        auto productState = compressedStateName(stateIndexes[pairIndex], stateCount);
+
+        productStates.insert(productState);
+
+        if (acceptingPairs[pairIndex]) productAcceptingStates.insert(productState);
+    }
+
+    for (auto [startPair, endPair, c] : transitions) {
+        if (!productivePairs[startPair] || !productivePairs[endPair]) continue;
+
+        productEdges.insert(Edge(compressedStateName(stateIndexes[startPair], stateCount), compressedStateName(stateIndexes[endPair], stateCount), c));
+    }
+
+    FiniteAutomata productDfa(productStates, compressedStateName(0, stateCount), productAcceptingStates, productEdges);
+
+    return shouldMinimize ? productDfa.dfa2minDfa() : productDfa;
+};
+
+FiniteAutomata FiniteAutomata::intersect(FiniteAutomata other)
+{
+    return FiniteAutomata::product(*this, other, INTERSECT, false);
+};
+
+FiniteAutomata FiniteAutomata::intersect(FiniteAutomata other, bool shouldMinimize)
+{
+    return FiniteAutomata::product(*this, other, INTERSECT, shouldMinimize);
+};
+
+FiniteAutomata FiniteAutomata::unite(FiniteAutomata other)
+{
+    return FiniteAutomata::product(*this, other, UNITE, false);
+};
+
+FiniteAutomata FiniteAutomata::unite(FiniteAutomata other, bool shouldMinimize)
+{
+    return FiniteAutomata::product(*this, other, UNITE, shouldMinimize);
+};
+
+FiniteAutomata FiniteAutomata::difference(FiniteAutomata other)
+{
+    return FiniteAutomata::product(*this, other, DIFFERENCE, false);
+};
+
+FiniteAutomata FiniteAutomata::difference(FiniteAutomata other, bool shouldMinimize)
+{
+    return FiniteAutomata::product(*this, other, DIFFERENCE, shouldMinimize);
+};
+
+FiniteAutomata FiniteAutomata::symmetricDifference(FiniteAutomata other)
+{
+    return FiniteAutomata::product(*this, other, SYMMETRIC_DIFFERENCE, false);
+};
+
+FiniteAutomata FiniteAutomata::symmetricDifference(FiniteAutomata other, bool shouldMinimize)
+{
+    return FiniteAutomata::product(*this, other, SYMMETRIC_DIFFERENCE, shouldMinimize);
+};
+
+bool FiniteAutomata::isIntersectionEmpty(FiniteAutomata fa1, FiniteAutomata fa2)
+{
+    // a word is in both languages iff some path reads it in both automata at once, so pairs of single states suffice (no subsets)
+
+    IndexedAutomata automata1(fa1);
+    IndexedAutomata automata2(fa2);
+
+    std::unordered_set<long long> visitedPairs;
+    std::vector<std::pair<int, int>> stack;
+
+    auto visit = [&] (const std::vector<int>& states1, const std::vector<int>& states2) {
+        for (auto state1 : states1) for (auto state2 : states2) {
+            if (visitedPairs.insert(((long long) state1 << 32) | state2).second) stack.push_back({ state1, state2 });
+        }
+    };
+
+    visit(automata1.getStartSubset(), automata2.getStartSubset());
+
+    while (!stack.empty()) {
+        auto [state1, state2] = stack.back();
+
+        stack.pop_back();
+
+        if (automata1.acceptingStates[state1] && automata2.acceptingStates[state2]) return false;
+
+        // both transition lists are sorted by letter, so shared letters are found with a merge
+        auto& transitions1 = automata1.transitions[state1];
+        auto& transitions2 = automata2.transitions[state2];
+
+        int i = 0;
+        int j = 0;
+
+        while (i < transitions1.size() && j < transitions2.size()) {
+            char c1 = transitions1[i].first;
+            char c2 = transitions2[j].first;
+
+            if (c1 < c2) i++;
+            else if (c2 < c1) j++;
+            else {
+                std::vector<int> endStates1;
+                std::vector<int> endStates2;
+
+                for (;i<transitions1.size() && transitions1[i].first == c1;i++) endStates1.push_back(transitions1[i].second);
+                for (;j<transitions2.size() && transitions2[j].first == c2;j++) endStates2.push_back(transitions2[j].second);
+
+                visit(automata1.closure(endStates1), automata2.closure(endStates2));
+            }
+        }
+    }
+
+    return true;
+};
+
+bool FiniteAutomata::isEmpty()
+{
+    return !this->shortestAcceptedWord().has_value();
+};
+
+bool FiniteAutomata::isUniversal()
+{
+    // every reachable subset state has to accept, the dead (empty) subset included
+
+    IndexedAutomata automata(*this);
+
+    std::unordered_set<std::vector<int>> visitedSubsets = { automata.getStartSubset() };
+    std::vector<std::vector<int>> stack = { automata.getStartSubset() };
+
+    while (!stack.empty()) {
+        auto subset = stack.back();
+
+        stack.pop_back();
+
+        if (!automata.isAccepting(subset)) return false;
+
+        for (auto c : automata.alphabet) {
+            auto endSubset = automata.step(subset, c);
+
+            if (visitedSubsets.insert(endSubset).second) stack.push_back(endSubset);
+        }
+    }
+
+    return true;
+};
+
+bool FiniteAutomata::isFinite()
+{
+    // the language is infinite iff a lettered cycle runs through a state that is both reachable and can reach acceptance
+    // λ edges are folded into closures, so [state] -> closure of its letter successors, then kahn's algorithm looks for a cycle among useful states
+
+    IndexedAutomata automata(*this);
+
+    int stateCount = automata.getStateCount();
+
+    std::vector<std::vector<int>> successors(stateCount);
+    std::vector<std::vector<int>> predecessors(stateCount);
+
+    for (int state = 0;state<stateCount;state++) {
+        std::vector<int> endStates;
+
+        for (auto [_, endState] : automata.transitions[state]) endStates.push_back(endState);
+
+        for (auto endState : automata.closure(endStates)) {
+            successors[state].push_back(endState);
+            predecessors[endState].push_back(state);
+        }
+    }
+
+    auto search = [] (std::vector<int> sources, std::vector<std::vector<int>>& neighbors, std::vector<bool>& visited) {
+        for (auto source : sources) visited[source] = true;
+
+        while (!sources.empty()) {
+            int state = sources.back();
+
+            sources.pop_back();
+
+            for (auto neighbor : neighbors[state]) {
+                if (visited[neighbor]) continue;
+
+                visited[neighbor] = true;
+                sources.push_back(neighbor);
+            }
+        }
+    };
+
+    std::vector<bool> reachableStates(stateCount, false);
+    search(automata.getStartSubset(), successors, reachableStates);
+
+    std::vector<int> acceptingClosureStates;
+
+    // a state accepts once its closure does, which is the same as reaching an accepting state backwards through λ edges
+    for (int state = 0;state<stateCount;state++) if (automata.isAccepting(automata.closure({ state }))) acceptingClosureStates.push_back(state);
+
+    std::vector<bool> productiveStates(stateCount, false);
+    search(acceptingClosureStates, predecessors, productiveStates);
+
+    std::vector<int> inDegrees(stateCount, 0);
+    int usefulStateCount = 0;
+
+    for (int state = 0;state<stateCount;state++) {
+        if (!reachableStates[state] || !productiveStates[state]) continue;
+
+        usefulStateCount++;
+
+        for (auto endState : successors[state]) if (reachableStates[endState] && productiveStates[endState]) inDegrees[endState]++;
+    }
+
+    std::vector<int> stack;
+
+    for (int state = 0;state<stateCount;state++) if (reachableStates[state] && productiveStates[state] && inDegrees[state] == 0) stack.push_back(state);
+
+    int sortedStateCount = 0;
+
+    while (!stack.empty()) {
+        int state = stack.back();
+
+        stack.pop_back();
+
+        sortedStateCount++;
+
+        for (auto endState : successors[state]) {
+            if (!reachableStates[endState] || !productiveStates[endState]) continue;
+
+            if (--inDegrees[endState] == 0) stack.push_back(endState);
+        }
+    }
+
+    // states left unsorted lie on a cycle
+    return sortedStateCount == usefulStateCount;
+};
+
+std::optional<std::string> FiniteAutomata::shortestAcceptedWord()
+{
+    // bfs over single states, λ edges are folded into closures so every bfs layer is one letter longer
+
+    IndexedAutomata automata(*this);
+
+    int stateCount = automata.getStateCount();
+
+    // [state] = [previous state, letter], -2 for unvisited and -1 for start states
+    std::vector<std::pair<int, char>> previousStates(stateCount, { -2, '\0' });
+
+    std::queue<int> queue;
+
+    for (auto startState : automata.getStartSubset()) {
+        previousStates[startState] = { -1, '\0' };
+        queue.push(startState);
+    }
+
+    while (!queue.empty()) {
+        int state = queue.front();
+
+        queue.pop();
+
+        if (automata.acceptingStates[state]) {
+            std::string word;
+
+            for (;previousStates[state].first != -1;state = previousStates[state].first) word += previousStates[state].second;
+
+            std::reverse(word.begin(), word.end());
+
+            return word;
+        }
+
+        for (auto [c, endState] : automata.transitions[state]) {
+            for (auto closureState : automata.closure({ endState })) {
+                if (previousStates[closureState].first != -2) continue;
+
+                previousStates[closureState] = { state, c };
+                queue.push(closureState);
+            }
+        }
+    }
+
+    return std::nullopt;
+};
+
+std::string FiniteAutomata::countAccepted(int length)
+{
+    // counting words (not paths) needs a dfa, then [state] = number of words of the current length that lead there
+
+    if (length < 0) throw std::runtime_error("FiniteAutomata countAccepted: length must be non negative");
+
+    auto dfa = IndexedAutomata(*this).determinize();
+
+    int stateCount = dfa.getStateCount();
+
+    std::vector<BigCount> counts(stateCount);
+    counts[dfa.startState] = 1;
+
+    for (int step = 0;step<length;step++) {
+        std::vector<BigCount> nextCounts(stateCount);
+
+        for (int state = 0;state<stateCount;state++) {
+            if (counts[state].isZero()) continue;
+
+            for (auto [_, endState] : dfa.transitions[state]) nextCounts[endState] += counts[state];
+        }
+
+        counts = std::move(nextCounts);
+    }
+
+    BigCount total;
+
+    for (int state = 0;state<stateCount;state++) if (dfa.acceptingStates[state]) total += counts[state];
+
+    return total.toString();
+};
+
+unsigned long long FiniteAutomata::countAccepted(int length, unsigned long long modulus)
+{
+    if (length < 0) throw std::runtime_error("FiniteAutomata countAccepted: length must be non negative");
+
+    if (modulus == 0) throw std::runtime_error("FiniteAutomata countAccepted: modulus must be positive");
+
+    auto dfa = IndexedAutomata(*this).determinize();
+
+    int stateCount = dfa.getStateCount();
+
+    // sum modulo without overflowing, operands are already reduced
+    auto add = [modulus] (unsigned long long a, unsigned long long b) {
+        return a >= modulus - b ? a - (modulus - b) : a + b;
+    };
+
+    std::vector<unsigned long long> counts(stateCount, 0);
+    counts[dfa.startState] = 1 % modulus;
+
+    for (int step = 0;step<length;step++) {
+        std::vector<unsigned long long> nextCounts(stateCount, 0);
+
+        for (int state = 0;state<stateCount;state++) {
+            if (counts[state] == 0) continue;
+
+            for (auto [_, endState] : dfa.transitions[state]) nextCounts[endState] = add(nextCounts[endState], counts[state]);
+        }
+
+        counts = std::move(nextCounts);
+    }
+
+    unsigned long long total = 0;
+
+    for (int state = 0;state<stateCount;state++) if (dfa.acceptingStates[state]) total = add(total, counts[state]);
+
+    return total;
+};
+
+bool FiniteAutomata::matches(std::string str)
+{
+    if (!this->isDeterministic()) throw std::runtime_error("FiniteAutomata matches: only callable for DFA");
+
+    std::string state = this->startState;
+
+    for (auto letter : str) {
+        auto transitionsAtState = this->transitionTable[state];
+
+        if (!transitionsAtState.contains(letter)) return false;
+
+        state = *transitionsAtState[letter].begin();
+    }
+
+    return this->acceptingStates.contains(state);
+};
+
+FiniteAutomata FiniteAutomata::canonicalize()
+{
+    auto canonicalDfa = IndexedAutomata(*this).canonicalize();
+
+    int stateCount = canonicalDfa.getStateCount();
+
+    std::unordered_set<std::string> canonicalStates;
+    std::unordered_set<std::string> canonicalAcceptingStates;
+    std::unordered_set<Edge> canonicalEdges;
+
+    for (int state = 0;state<stateCount;state++) {
+        auto canonicalState = compressedStateName(state, stateCount);
+
+        canonicalStates.insert(canonicalState);
+
+        if (canonicalDfa.acceptingStates[state]) canonicalAcceptingStates.insert(canonicalState);
+
+        for (auto [c, endState] : canonicalDfa.transitions[state]) canonicalEdges.insert(Edge(canonicalState, compressedStateName(endState, stateCount), c));
+    }
+
+    return FiniteAutomata(canonicalStates, compressedStateName(0, stateCount), canonicalAcceptingStates, canonicalEdges);
+};
+
+LanguageFingerprint FiniteAutomata::fingerprint()
+{
+    auto& cache = *this->fingerprintCache;
+
+    std::call_once(cache.onceFlag, [this, &cache] () {
+        auto canonicalDfa = IndexedAutomata(*this).canonicalize();
+
+        // two independently seeded splitmix style hashes over the canonical table make up the 128 bits
+        auto mix = [] (unsigned long long x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+
+            return x ^ (x >> 31);
+        };
+
+        unsigned long long high = 0x243f6a8885a308d3;
+        unsigned long long low = 0x13198a2e03707344;
+
+        auto absorb = [&] (unsigned long long value) {
+            high = mix(high ^ (value + 0x9e3779b97f4a7c15));
+            low = mix((low + value) * 0xff51afd7ed558ccd);
+        };
+
+        absorb(canonicalDfa.getStateCount());
+
+        for (int state = 0;state<canonicalDfa.getStateCount();state++) {
+            absorb(canonicalDfa.acceptingStates[state]);
+            absorb(canonicalDfa.transitions[state].size());
+
+            for (auto [c, endState] : canonicalDfa.transitions[state]) {
+                absorb((unsigned char) c);
+                absorb(endState);
+            }
+        }
+
+        cache.fingerprint = { high, low };
+    });
+
+    return cache.fingerprint;
+};
+
+bool FiniteAutomata::isIsomorphism(FiniteAutomata dfa1, FiniteAutomata dfa2)
+{
+    if (!dfa1.isDeterministic() || !dfa2.isDeterministic()) throw std::runtime_error("FiniteAutomata isIsomorphism: only callable on DFAs");
+
+    // run bfs on both dfa graphs and look for structural differences
+
+    std::unordered_set<std::string> visited1;
+    std::unordered_set<std::string> visited2;
+
+    std::queue<std::string> queue1;
+    std::queue<std::string> queue2;
+
+    queue1.push(dfa1.startState);
+    queue2.push(dfa2.startState);
+
+    while (!queue1.empty()) {
+        auto currentState1 = queue1.front();
         auto currentState2 = queue2.front();
 
         queue1.pop();
@@ -704,97 +1729,310 @@ bool FiniteAutomata::isIsomorphism(FiniteAutomata dfa1, FiniteAutomata dfa2)
 
 bool FiniteAutomata::isLanguageEquivalence(FiniteAutomata fa1, FiniteAutomata fa2)
 {
-    auto dfa1 = fa1.lnfa2nfa().nfa2dfa().dfa2minDfa();
-    auto dfa2 = fa2.lnfa2nfa().nfa2dfa().dfa2minDfa();
+    return FiniteAutomata::isLanguageEquivalence(fa1, fa2, UNION_FIND);
+};
+
+bool FiniteAutomata::isLanguageEquivalence(FiniteAutomata fa1, FiniteAutomata fa2, LanguageEquivalenceAlgorithm algorithm)
+{
+    if (algorithm == ANTICHAIN) return FiniteAutomata::isLanguageIncluded(fa1, fa2) && FiniteAutomata::isLanguageIncluded(fa2, fa1);
+
+    if (algorithm == FINGERPRINT) return fa1.fingerprint() == fa2.fingerprint();
 
-    return isIsomorphism(dfa1, dfa2);
+    return !FiniteAutomata::findCounterexample(fa1, fa2).has_value();
 };
 
-std::string FiniteAutomata::toString()
+std::optional<std::string> FiniteAutomata::findCounterexample(FiniteAutomata fa1, FiniteAutomata fa2)
 {
-    std::string output;
+    // hopcroft karp, walks pairs of subset states of both automata breadth first without building either dfa
+    // pairs that are merged in the union find are assumed equivalent, so a pair already implied by earlier ones is never expanded
+    // the first pair that disagrees on acceptance is reached by a shortest distinguishing word
 
-    output += "States: " + concatStrSet(this->states, ", ");
+    IndexedAutomata automata1(fa1);
+    IndexedAutomata automata2(fa2);
 
-    output += "\n";
+    std::vector<char> alphabet;
+    std::set_union(automata1.alphabet.begin(), automata1.alphabet.end(), automata2.alphabet.begin(), automata2.alphabet.end(), std::back_inserter(alphabet));
 
-    output += "Start State: " + this->startState + "";
+    // subset states of both sides share one union find, the empty subset is each side's dead state
+    std::unordered_map<std::vector<int>, int> subsetIds1;
+    std::unordered_map<std::vector<int>, int> subsetIds2;
+    std::vector<int> parents;
 
-    output += "\n";
+    auto getSubsetId = [&parents] (std::unordered_map<std::vector<int>, int>& subsetIds, const std::vector<int>& subset) {
+        auto [subsetId, isInserted] = subsetIds.try_emplace(subset, parents.size());
 
-    output += "Accepting States: " + concatStrSet(this->acceptingStates, ", ");
+        if (isInserted) parents.push_back(subsetId->second);
 
-    output += "\n";
+        return subsetId->second;
+    };
+
+    auto find = [&parents] (int id) {
+        while (parents[id] != id) {
+            parents[id] = parents[parents[id]];
+            id = parents[id];
+        }
 
-    std::unordered_set<std::string> edgeStrSet;
-    for (auto edge : this->edges) edgeStrSet.insert(edge.toString());
+        return id;
+    };
 
-    output += "Edges: \n\t" + concatStrSet(edgeStrSet, "\n\t");
+    // [subset1, subset2, index of the pair it was reached from, letter it was reached by]
+    std::vector<std::tuple<std::vector<int>, std::vector<int>, int, char>> pairs;
 
-    if (this->edges.empty()) output += "NONE";
+    auto startSubset1 = automata1.getStartSubset();
+    auto startSubset2 = automata2.getStartSubset();
 
-    return output;
+    parents[find(getSubsetId(subsetIds1, startSubset1))] = find(getSubsetId(subsetIds2, startSubset2));
+
+    pairs.push_back({ startSubset1, startSubset2, -1, '\0' });
+
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) {
+        // copy since pushing below can reallocate pairs
+        auto [subset1, subset2, _, __] = pairs[pairIndex];
+
+        if (automata1.isAccepting(subset1) != automata2.isAccepting(subset2)) {
+            std::string counterexample;
+
+            for (int index = pairIndex;std::get<2>(pairs[index]) != -1;index = std::get<2>(pairs[index])) counterexample += std::get<3>(pairs[index]);
+
+            std::reverse(counterexample.begin(), counterexample.end());
+
+            return counterexample;
+        }
+
+        for (auto c : alphabet) {
+            auto endSubset1 = automata1.step(subset1, c);
+            auto endSubset2 = automata2.step(subset2, c);
+
+            int root1 = find(getSubsetId(subsetIds1, endSubset1));
+            int root2 = find(getSubsetId(subsetIds2, endSubset2));
+
+            if (root1 == root2) continue;
+
+            parents[root1] = root2;
+
+            pairs.push_back({ endSubset1, endSubset2, pairIndex, c });
+        }
+    }
+
+    return std::nullopt;
 };
 
-std::string FiniteAutomata::toDOT()
+bool FiniteAutomata::isLanguageIncluded(FiniteAutomata fa1, FiniteAutomata fa2)
 {
-    std::string output;
+    return !FiniteAutomata::findInclusionCounterexample(fa1, fa2).has_value();
+};
 
-    output += "digraph FiniteAutomata {";
+std::optional<std::string> FiniteAutomata::findInclusionCounterexample(FiniteAutomata fa1, FiniteAutomata fa2)
+{
+    // breadth first over pairs [single state of fa1, subset state of fa2], so only fa2 is ever determinized and only lazily
+    // a pair is a counterexample when fa1 accepts but the subset does not
+    // (state, subset) is pruned when (state, smaller subset) was already found, since every word that escapes the larger subset escapes the smaller one too
+    // so per state only the minimal subsets found so far are kept
+
+    IndexedAutomata automata1(fa1);
+    IndexedAutomata automata2(fa2);
+
+    // [state1, subset2, index of the pair it was reached from, letter it was reached by]
+    std::vector<std::tuple<int, std::vector<int>, int, char>> pairs;
 
-    output += "\n";
+    // a queued pair is superseded when a smaller subset for the same state shows up at the same depth
+    // (one found deeper cant replace it without losing the shortest counterexample)
+    std::vector<bool> supersededPairs;
+    std::vector<int> pairDepths;
 
-    output += "\trankdir=LR;";
+    // [state1] = indexes of the pairs currently in its antichain
+    std::vector<std::vector<int>> antichains(automata1.getStateCount());
 
-    output += "\n";
+    auto addPair = [&] (int state1, std::vector<int> subset2, int previousPairIndex, char c) {
+        auto& antichain = antichains[state1];
 
-    output += "\tnodesep=1.0;";
+        int depth = previousPairIndex == -1 ? 0 : pairDepths[previousPairIndex] + 1;
 
-    output += "\n";
+        for (auto pairIndex : antichain) {
+            auto& antichainSubset = std::get<1>(pairs[pairIndex]);
+
+            if (std::includes(subset2.begin(), subset2.end(), antichainSubset.begin(), antichainSubset.end())) return;
+        }
 
-    output += "\tranksep=1.0;";
+        std::erase_if(antichain, [&] (int pairIndex) {
+            auto& antichainSubset = std::get<1>(pairs[pairIndex]);
 
-    output += "\n";
+            if (pairDepths[pairIndex] != depth || !std::includes(antichainSubset.begin(), antichainSubset.end(), subset2.begin(), subset2.end())) return false;
 
-    output += "\t\"$\" [shape=point, style=invis, width=0];";
+            supersededPairs[pairIndex] = true;
 
-    output += "\n";
+            return true;
+        });
 
-    output += "\t\"$\" -> \"" + this->startState + "\";";
+        antichain.push_back(pairs.size());
 
-    output += "\n";
+        pairs.push_back({ state1, subset2, previousPairIndex, c });
+        supersededPairs.push_back(false);
+        pairDepths.push_back(depth);
+    };
 
-    std::unordered_set<std::string> acceptingStateStrSet;
-    for (auto acceptingState : this->acceptingStates) acceptingStateStrSet.insert("\t\"" + acceptingState + "\" [penwidth=5];");
+    auto startSubset2 = automata2.getStartSubset();
 
-    output += concatStrSet(acceptingStateStrSet, "\n");
+    for (auto startState1 : automata1.getStartSubset()) addPair(startState1, startSubset2, -1, '\0');
 
-    output += "\n";
+    for (int pairIndex = 0;pairIndex<pairs.size();pairIndex++) {
+        if (supersededPairs[pairIndex]) continue;
 
-    std::unordered_set<std::string> edgeDotSet;
+        // copy since adding pairs below can reallocate pairs
+        auto [state1, subset2, _, __] = pairs[pairIndex];
+
+        if (automata1.acceptingStates[state1] && !automata2.isAccepting(subset2)) {
+            std::string counterexample;
+
+            for (int index = pairIndex;std::get<2>(pairs[index]) != -1;index = std::get<2>(pairs[index])) counterexample += std::get<3>(pairs[index]);
+
+            std::reverse(counterexample.begin(), counterexample.end());
+
+            return counterexample;
+        }
+
+        auto& transitions1 = automata1.transitions[state1];
+
+        for (int i = 0;i<transitions1.size();) {
+            char c = transitions1[i].first;
+
+            std::vector<int> endStates1;
+
+            for (;i<transitions1.size() && transitions1[i].first == c;i++) endStates1.push_back(transitions1[i].second);
+
+            auto endSubset2 = automata2.step(subset2, c);
+
+            for (auto endState1 : automata1.closure(endStates1)) addPair(endState1, endSubset2, pairIndex, c);
+        }
+    }
+
+    return std::nullopt;
+};
+
+std::string FiniteAutomata::toString()
+{
+    std::ostringstream output;
+
+    this->toString(output);
+
+    return output.str();
+};
 
-    // start -> transition class, letter end states
+void FiniteAutomata::toString(std::ostream& output)
+{
+    // sorted so the output is the same on every run, only pointers are sorted so nothing is formatted twice
+    auto writeStates = [&output] (const std::unordered_set<std::string>& states) {
+        std::vector<const std::string*> sortedStates;
+        sortedStates.reserve(states.size());
 
-    for (auto [startState, transitions] : this->transitionTable) {
-        std::unordered_map<std::string, std::unordered_set<Letter>> parallelEdges;
+        for (auto& state : states) sortedStates.push_back(&state);
 
-        for (auto [letter, endStates] : transitions) for (auto endState : endStates) parallelEdges[endState].insert(letter);
+        std::sort(sortedStates.begin(), sortedStates.end(), [] (const std::string* state1, const std::string* state2) { return *state1 < *state2; });
 
-        for (auto [endState, letters] : parallelEdges) {
-            std::unordered_set<std::string> lettersStrSet;
-            for (auto letter : letters) lettersStrSet.insert(letter.has_value() ? std::string(1, letter.value()) : "λ");
+        for (int i = 0;i<sortedStates.size();i++) {
+            if (i != 0) output << ", ";
 
-            edgeDotSet.insert("\t\"" + startState + "\" -> \"" + endState + "\" [label=\"" + concatStrSet(lettersStrSet, ",") + "\"];");
+            output << *sortedStates[i];
         }
+    };
+
+    output << "States: ";
+    writeStates(this->states);
+
+    output << "\n";
+
+    output << "Start State: " << this->startState;
+
+    output << "\n";
+
+    output << "Accepting States: ";
+    writeStates(this->acceptingStates);
+
+    output << "\n";
+
+    output << "Edges: \n\t";
+
+    auto sortedEdges = sortedEdgesOf(this->edges);
+
+    for (int i = 0;i<sortedEdges.size();i++) {
+        if (i != 0) output << "\n\t";
+
+        sortedEdges[i]->toString(output);
     }
 
-    output += concatStrSet(edgeDotSet, "\n");
+    if (this->edges.empty()) output << "NONE";
+};
+
+std::string FiniteAutomata::toDOT()
+{
+    std::ostringstream output;
+
+    this->toDOT(output);
+
+    return output.str();
+};
+
+void FiniteAutomata::toDOT(std::ostream& output)
+{
+    output << "digraph FiniteAutomata {";
+
+    output << "\n";
+
+    output << "\trankdir=LR;";
 
-    output += "\n";
+    output << "\n";
+
+    output << "\tnodesep=1.0;";
+
+    output << "\n";
+
+    output << "\tranksep=1.0;";
+
+    output << "\n";
+
+    output << "\t\"$\" [shape=point, style=invis, width=0];";
+
+    output << "\n";
+
+    output << "\t\"$\" -> \"" << this->startState << "\";";
+
+    output << "\n";
+
+    std::vector<const std::string*> sortedAcceptingStates;
+
+    for (auto& acceptingState : this->acceptingStates) sortedAcceptingStates.push_back(&acceptingState);
+
+    std::sort(sortedAcceptingStates.begin(), sortedAcceptingStates.end(), [] (const std::string* state1, const std::string* state2) { return *state1 < *state2; });
+
+    for (int i = 0;i<sortedAcceptingStates.size();i++) output << (i == 0 ? "" : "\n") << "\t\"" << *sortedAcceptingStates[i] << "\" [penwidth=5];";
+
+    output << "\n";
+
+    // parallel edges share one line, edges are sorted by start then end state so they arrive grouped
+    auto sortedEdges = sortedEdgesOf(this->edges);
+
+    std::stable_sort(sortedEdges.begin(), sortedEdges.end(), [] (const Edge* edge1, const Edge* edge2) {
+        return std::tie(edge1->start, edge1->end) < std::tie(edge2->start, edge2->end);
+    });
+
+    for (int i = 0;i<sortedEdges.size();i++) {
+        auto edge = sortedEdges[i];
+
+        bool isFirstParallelEdge = i == 0 || edge->start != sortedEdges[i - 1]->start || edge->end != sortedEdges[i - 1]->end;
+        bool isLastParallelEdge = i == sortedEdges.size() - 1 || edge->start != sortedEdges[i + 1]->start || edge->end != sortedEdges[i + 1]->end;
+
+        if (isFirstParallelEdge) output << (i == 0 ? "" : "\n") << "\t\"" << edge->start << "\" -> \"" << edge->end << "\" [label=\"";
+        else output << ",";
+
+        if (edge->letter.has_value()) output << edge->letter.value();
+        else output << "λ";
+
+        if (isLastParallelEdge) output << "\"];";
+    }
 
-    output += "}";
+    output << "\n";
 
-    return output;
+    output << "}";
 };
 
 void FiniteAutomata::exportGraph(std::string outputDirPath, std::string outputFileName) {
@@ -804,7 +2042,7 @@ void FiniteAutomata::exportGraph(std::string outputDirPath, std::string outputFi
 
     std::ofstream dotOutputFile(dotOutputFilePath);
 
-    dotOutputFile << this->toDOT();
+    this->toDOT(dotOutputFile);
 
     dotOutputFile.close();
 
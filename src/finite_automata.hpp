@@ -5,6 +5,11 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <optional>
+#include <vector>
+#include <tuple>
+#include <ostream>
+#include <memory>
+#include <mutex>
 
 #include "regular_expression.hpp"
 
@@ -27,6 +32,7 @@ class Edge
         bool operator==(const Edge&) const = default;
 
         std::string toString();
+        void toString(std::ostream& output) const;
 };
 
 template <>
@@ -34,6 +40,44 @@ struct std::hash<Edge> {
     size_t operator()(const Edge& edge) const;
 };
 
+enum StateEliminationOrdering
+{
+    ARBITRARY,          // whatever order the state set iterates in
+    MIN_DEGREE_PRODUCT, // fewest new edges (in degree x out degree) first, recomputed as states are spliced out
+    MIN_WEIGHT,         // smallest added expression size first, computed once up front
+    DYNAMIC_MIN_WEIGHT  // smallest added expression size first, recomputed as states are spliced out
+};
+
+// 128 bit hash of a canonical min dfa, equal languages always share one and different languages collide with negligible probability
+class LanguageFingerprint
+{
+    public:
+        unsigned long long high;
+        unsigned long long low;
+
+        bool operator==(const LanguageFingerprint&) const = default;
+};
+
+template <>
+struct std::hash<LanguageFingerprint> {
+    size_t operator()(const LanguageFingerprint& fingerprint) const;
+};
+
+enum ProductOperation
+{
+    INTERSECT,           // accepted by both
+    UNITE,               // accepted by either
+    DIFFERENCE,          // accepted by the first but not the second
+    SYMMETRIC_DIFFERENCE // accepted by exactly one
+};
+
+enum LanguageEquivalenceAlgorithm
+{
+    UNION_FIND, // hopcroft karp over pairs of subset states, see FiniteAutomata::findCounterexample
+    ANTICHAIN,  // inclusion both ways, see FiniteAutomata::findInclusionCounterexample
+    FINGERPRINT // compares (cached) fingerprints, see FiniteAutomata::fingerprint
+};
+
 class FiniteAutomata
 {
     private:
@@ -50,13 +94,31 @@ class FiniteAutomata
         // [endState][letter] = set<startState>
         std::unordered_map<std::string, std::unordered_map<Letter, std::unordered_set<std::string>>> invertedTransitionTable;
 
-        // these insert the re into the graph starting at the root state then return the state where the re terminated for easy chaining
-        std::string addRe(std::string rootState, RegularExpression re);
-        std::string addEmptyRe(std::string rootState);
-        std::string addCharacterRe(std::string rootState, char characterExpression);
-        std::string addConcatRe(std::string rootState, RegularExpression re1, RegularExpression re2);
-        std::string addPlusRe(std::string rootState, RegularExpression re1, RegularExpression re2);
-        std::string addStarRe(std::string rootState, RegularExpression re);
+        // thompson construction over integer state ids (see FiniteAutomata::re2lnfa)
+        class ThompsonBuilder
+        {
+            private:
+                int stateCount = 0;
+
+                // [start, end, letter], reserved up front from the expression size
+                std::vector<std::tuple<int, int, Letter>> edges;
+
+                // sub expressions that still need to be inserted between their (already allocated) start and end states
+                std::vector<std::tuple<int, int, RegularExpression>> pendingRes;
+
+                int allocateState();
+
+                // these insert the re into the graph between the given start and end states, any nested re is queued on pendingRes instead of recursing
+                void addRe(int startState, int endState, RegularExpression re);
+                void addEmptyRe(int startState, int endState);
+                void addCharacterRe(int startState, int endState, char characterExpression);
+                void addConcatRe(int startState, int endState, RegularExpression re1, RegularExpression re2);
+                void addPlusRe(int startState, int endState, RegularExpression re1, RegularExpression re2);
+                void addStarRe(int startState, int endState, RegularExpression re);
+
+            public:
+                FiniteAutomata build(RegularExpression re);
+        };
 
         std::unordered_set<std::string> getStatesDirectlyStartingAt(std::string state);
         std::unordered_set<std::string> getStatesDirectlyStartingAt(std::string state, Letter letter);
@@ -70,6 +132,21 @@ class FiniteAutomata
 
         std::unordered_map<std::string, int> getMinDfaEquivalenceClassIndexes();
 
+        // lazy product over reachable pairs of subset states, see FiniteAutomata::intersect
+        static FiniteAutomata product(FiniteAutomata fa1, FiniteAutomata fa2, ProductOperation operation, bool shouldMinimize);
+
+        // shared between copies, which is safe since an automata never changes after construction
+        class FingerprintCache
+        {
+            public:
+                std::once_flag onceFlag;
+                LanguageFingerprint fingerprint;
+        };
+
+        std::shared_ptr<FingerprintCache> fingerprintCache = std::make_shared<FingerprintCache>();
+
+        friend class IndexedAutomata;
+
     public:
         static FiniteAutomata create(std::unordered_set<std::string> states, std::string startState, std::unordered_set<std::string> acceptingStates, std::unordered_set<Edge> edges);
 
@@ -78,13 +155,24 @@ class FiniteAutomata
         bool hasLambdaMoves();
         bool isDeterministic();
 
+        // shouldSimplify runs RegularExpression::simplify on the input first, off by default so the construction follows the expression as written
         static FiniteAutomata re2lnfa(RegularExpression re);
+        static FiniteAutomata re2lnfa(RegularExpression re, bool shouldSimplify);
+        static FiniteAutomata re2nfa(RegularExpression re);
+        static FiniteAutomata re2dfa(RegularExpression re);
 
         FiniteAutomata lnfa2renfa();
 
+        // ARBITRARY unless an ordering is given, the heuristics usually give smaller expressions but change the output
         RegularExpression lnfa2re();
+        RegularExpression lnfa2re(StateEliminationOrdering ordering);
+        RegularExpression lnfa2re(StateEliminationOrdering ordering, RegularExpressionContext& context);
+
+        // shouldSimplify runs RegularExpression::simplify on the result, off by default so the output is the raw state elimination
+        RegularExpression lnfa2re(StateEliminationOrdering ordering, RegularExpressionContext& context, bool shouldSimplify);
 
         FiniteAutomata lnfa2nfa();
+        FiniteAutomata lnfa2compactNfa();
 
         FiniteAutomata nfa2dfa();
 
@@ -92,14 +180,57 @@ class FiniteAutomata
 
         FiniteAutomata dfa2complement();
 
+        // these accept any automata and return a trimmed dfa, shouldMinimize additionally runs dfa2minDfa on it
+        FiniteAutomata intersect(FiniteAutomata other);
+        FiniteAutomata intersect(FiniteAutomata other, bool shouldMinimize);
+        FiniteAutomata unite(FiniteAutomata other);
+        FiniteAutomata unite(FiniteAutomata other, bool shouldMinimize);
+        FiniteAutomata difference(FiniteAutomata other);
+        FiniteAutomata difference(FiniteAutomata other, bool shouldMinimize);
+        FiniteAutomata symmetricDifference(FiniteAutomata other);
+        FiniteAutomata symmetricDifference(FiniteAutomata other, bool shouldMinimize);
+
+        // searches pairs of single states without building the product, stops at the first shared word
+        static bool isIntersectionEmpty(FiniteAutomata fa1, FiniteAutomata fa2);
+
         bool matches(std::string str);
 
+        // language queries, these work on any automata without building a full dfa first (except for counting)
+        bool isEmpty();
+        bool isUniversal(); // over the letters this automata uses
+        bool isFinite();
+
+        std::optional<std::string> shortestAcceptedWord();
+
+        // number of accepted words of exactly the given length, the first in decimal and the second modulo the given modulus
+        std::string countAccepted(int length);
+        unsigned long long countAccepted(int length, unsigned long long modulus);
+
+        // min dfa without dead states, named in bfs order taking letters in sorted order, so equal languages give identical automata
+        FiniteAutomata canonicalize();
+
+        // hash of the canonical form, computed once per automata and shared by its copies
+        LanguageFingerprint fingerprint();
+
         static bool isIsomorphism(FiniteAutomata dfa1, FiniteAutomata dfa2);
         static bool isLanguageEquivalence(FiniteAutomata fa1, FiniteAutomata fa2);
+        static bool isLanguageEquivalence(FiniteAutomata fa1, FiniteAutomata fa2, LanguageEquivalenceAlgorithm algorithm);
+
+        // a shortest word accepted by exactly one of the two automata, nullopt when their languages are equal
+        static std::optional<std::string> findCounterexample(FiniteAutomata fa1, FiniteAutomata fa2);
+
+        static bool isLanguageIncluded(FiniteAutomata fa1, FiniteAutomata fa2);
+
+        // a shortest word accepted by fa1 but not by fa2, nullopt when the language of fa1 is a subset of the language of fa2
+        static std::optional<std::string> findInclusionCounterexample(FiniteAutomata fa1, FiniteAutomata fa2);
 
         std::string toString();
         std::string toDOT();
 
+        // single pass emitters, states and edges are written in container order rather than sorted
+        void toString(std::ostream& output);
+        void toDOT(std::ostream& output);
+
         void exportGraph(std::string outputDirPath, std::string outputFileName);
 };
 
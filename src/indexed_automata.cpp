@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <queue>
+
+#include "indexed_automata.hpp"
+
+// subset hash
+
+size_t std::hash<std::vector<int>>::operator()(const std::vector<int>& subset) const
+{
+    size_t hash = subset.size();
+
+    for (auto state : subset) hash = hash * 1000003 ^ state;
+
+    return hash;
+};
+
+// indexed automata
+
+IndexedAutomata::IndexedAutomata(FiniteAutomata fa)
+{
+    std::unordered_map<std::string, int> stateIndexes;
+
+    for (auto state : fa.states) {
+        stateIndexes[state] = this->stateNames.size();
+        this->stateNames.push_back(state);
+    }
+
+    int stateCount = this->stateNames.size();
+
+    this->startState = stateIndexes[fa.startState];
+
+    this->acceptingStates.resize(stateCount, false);
+    for (auto acceptingState : fa.acceptingStates) this->acceptingStates[stateIndexes[acceptingState]] = true;
+
+    this->transitions.resize(stateCount);
+    this->lambdaTransitions.resize(stateCount);
+
+    for (auto edge : fa.edges) {
+        int startState = stateIndexes[edge.start];
+        int endState = stateIndexes[edge.end];
+
+        if (!edge.letter.has_value()) {
+            this->lambdaTransitions[startState].push_back(endState);
+
+            continue;
+        }
+
+        this->transitions[startState].push_back({ edge.letter.value(), endState });
+        this->alphabet.push_back(edge.letter.value());
+    }
+
+    for (auto& stateTransitions : this->transitions) std::sort(stateTransitions.begin(), stateTransitions.end());
+
+    std::sort(this->alphabet.begin(), this->alphabet.end());
+    this->alphabet.erase(std::unique(this->alphabet.begin(), this->alphabet.end()), this->alphabet.end());
+
+    this->marks.resize(stateCount, 0);
+};
+
+int IndexedAutomata::getStateCount()
+{
+    return this->stateNames.size();
+};
+
+std::vector<int> IndexedAutomata::closure(std::vector<int> states)
+{
+    this->markGeneration++;
+
+    std::vector<int> closedStates;
+    std::vector<int> stack;
+
+    for (auto state : states) {
+        if (this->marks[state] == this->markGeneration) continue;
+
+        this->marks[state] = this->markGeneration;
+        stack.push_back(state);
+    }
+
+    while (!stack.empty()) {
+        int state = stack.back();
+
+        stack.pop_back();
+
+        closedStates.push_back(state);
+
+        for (auto endState : this->lambdaTransitions[state]) {
+            if (this->marks[endState] == this->markGeneration) continue;
+
+            this->marks[endState] = this->markGeneration;
+            stack.push_back(endState);
+        }
+    }
+
+    std::sort(closedStates.begin(), closedStates.end());
+
+    return closedStates;
+};
+
+std::vector<int> IndexedAutomata::getStartSubset()
+{
+    return this->closure({ this->startState });
+};
+
+std::vector<int> IndexedAutomata::step(const std::vector<int>& subset, char c)
+{
+    std::vector<int> endStates;
+
+    for (auto state : subset) {
+        auto& stateTransitions = this->transitions[state];
+
+        // transitions are sorted by letter, so the ones reading c are a contiguous range
+        auto transition = std::lower_bound(stateTransitions.begin(), stateTransitions.end(), std::pair<char, int>(c, -1));
+
+        for (;transition != stateTransitions.end() && transition->first == c;transition++) endStates.push_back(transition->second);
+    }
+
+    return this->closure(endStates);
+};
+
+bool IndexedAutomata::isAccepting(const std::vector<int>& subset)
+{
+    for (auto state : subset) if (this->acceptingStates[state]) return true;
+
+    return false;
+};
+
+IndexedAutomata IndexedAutomata::determinize()
+{
+    IndexedAutomata dfa;
+
+    dfa.startState = 0;
+    dfa.alphabet = this->alphabet;
+
+    std::unordered_map<std::vector<int>, int> subsetIndexes;
+    std::vector<std::vector<int>> subsets = { this->getStartSubset() };
+
+    subsetIndexes[subsets[0]] = 0;
+
+    for (int subsetIndex = 0;subsetIndex<subsets.size();subsetIndex++) {
+        // copy since adding subsets below can reallocate subsets
+        auto subset = subsets[subsetIndex];
+
+        dfa.stateNames.push_back(std::to_string(subsetIndex));
+        dfa.acceptingStates.push_back(this->isAccepting(subset));
+        dfa.transitions.emplace_back();
+        dfa.lambdaTransitions.emplace_back();
+
+        for (auto c : this->alphabet) {
+            auto endSubset = this->step(subset, c);
+
+            if (endSubset.empty()) continue;
+
+            auto [endSubsetIndex, isInserted] = subsetIndexes.try_emplace(endSubset, subsets.size());
+
+            if (isInserted) subsets.push_back(endSubset);
+
+            // the alphabet is sorted, so the transitions come out sorted too
+            dfa.transitions[subsetIndex].push_back({ c, endSubsetIndex->second });
+        }
+    }
+
+    dfa.marks.resize(dfa.stateNames.size(), 0);
+
+    return dfa;
+};
+
+IndexedAutomata IndexedAutomata::canonicalize()
+{
+    auto dfa = this->determinize();
+
+    int stateCount = dfa.getStateCount();
+    int letterCount = dfa.alphabet.size();
+
+    // [state][letter index] = end state, -1 for the dead state
+    std::vector<std::vector<int>> table(stateCount, std::vector<int>(letterCount, -1));
+    std::vector<std::vector<int>> reversedEdges(stateCount);
+
+    for (int state = 0;state<stateCount;state++) {
+        for (auto [c, endState] : dfa.transitions[state]) {
+            int letterIndex = std::lower_bound(dfa.alphabet.begin(), dfa.alphabet.end(), c) - dfa.alphabet.begin();
+
+            table[state][letterIndex] = endState;
+            reversedEdges[endState].push_back(state);
+        }
+    }
+
+    // states that cannot reach acceptance behave exactly like the dead state, so they are folded into it
+
+    std::vector<bool> productiveStates = dfa.acceptingStates;
+    std::vector<int> stack;
+
+    for (int state = 0;state<stateCount;state++) if (productiveStates[state]) stack.push_back(state);
+
+    while (!stack.empty()) {
+        int state = stack.back();
+
+        stack.pop_back();
+
+        for (auto startState : reversedEdges[state]) {
+            if (productiveStates[startState]) continue;
+
+            productiveStates[startState] = true;
+            stack.push_back(startState);
+        }
+    }
+
+    for (auto& row : table) for (auto& endState : row) if (endState != -1 && !productiveStates[endState]) endState = -1;
+
+    IndexedAutomata canonicalDfa;
+
+    canonicalDfa.startState = 0;
+
+    if (!productiveStates[dfa.startState]) {
+        // empty language, a lone rejecting start state
+        canonicalDfa.stateNames = { "0" };
+        canonicalDfa.acceptingStates = { false };
+        canonicalDfa.transitions.resize(1);
+        canonicalDfa.lambdaTransitions.resize(1);
+        canonicalDfa.marks.resize(1, 0);
+
+        return canonicalDfa;
+    }
+
+    // moore refinement, a state's signature is its class plus the classes it moves to, repeated until the class count settles
+
+    std::vector<int> classes(stateCount);
+    for (int state = 0;state<stateCount;state++) classes[state] = dfa.acceptingStates[state] ? 1 : 0;
+
+    int classCount = -1;
+
+    while (true) {
+        std::unordered_map<std::vector<int>, int> signatureClasses;
+        std::vector<int> nextClasses(stateCount, -1);
+
+        for (int state = 0;state<stateCount;state++) {
+            if (!productiveStates[state]) continue;
+
+            std::vector<int> signature = { classes[state] };
+
+            for (auto endState : table[state]) signature.push_back(endState == -1 ? -1 : classes[endState]);
+
+            nextClasses[state] = signatureClasses.try_emplace(signature, signatureClasses.size()).first->second;
+        }
+
+        classes = nextClasses;
+
+        if (signatureClasses.size() == classCount) break;
+
+        classCount = signatureClasses.size();
+    }
+
+    std::vector<int> representatives(classCount, -1);
+    for (int state = 0;state<stateCount;state++) if (productiveStates[state] && representatives[classes[state]] == -1) representatives[classes[state]] = state;
+
+    // bfs numbering, the only remaining freedom in a minimal dfa
+
+    std::vector<int> canonicalIndexes(classCount, -1);
+    std::queue<int> queue;
+
+    canonicalIndexes[classes[dfa.startState]] = 0;
+    queue.push(classes[dfa.startState]);
+
+    int canonicalStateCount = 1;
+
+    std::vector<int> canonicalClasses;
+
+    while (!queue.empty()) {
+        int stateClass = queue.front();
+
+        queue.pop();
+
+        canonicalClasses.push_back(stateClass);
+
+        for (auto endState : table[representatives[stateClass]]) {
+            if (endState == -1 || canonicalIndexes[classes[endState]] != -1) continue;
+
+            canonicalIndexes[classes[endState]] = canonicalStateCount++;
+            queue.push(classes[endState]);
+        }
+    }
+
+    canonicalDfa.transitions.resize(canonicalStateCount);
+    canonicalDfa.lambdaTransitions.resize(canonicalStateCount);
+    canonicalDfa.marks.resize(canonicalStateCount, 0);
+
+    for (int canonicalState = 0;canonicalState<canonicalStateCount;canonicalState++) {
+        int representative = representatives[canonicalClasses[canonicalState]];
+
+        canonicalDfa.stateNames.push_back(std::to_string(canonicalState));
+        canonicalDfa.acceptingStates.push_back(dfa.acceptingStates[representative]);
+
+        for (int letterIndex = 0;letterIndex<letterCount;letterIndex++) {
+            int endState = table[representative][letterIndex];
+
+            if (endState == -1) continue;
+
+            canonicalDfa.transitions[canonicalState].push_back({ dfa.alphabet[letterIndex], canonicalIndexes[classes[endState]] });
+            canonicalDfa.alphabet.push_back(dfa.alphabet[letterIndex]);
+        }
+    }
+
+    std::sort(canonicalDfa.alphabet.begin(), canonicalDfa.alphabet.end());
+    canonicalDfa.alphabet.erase(std::unique(canonicalDfa.alphabet.begin(), canonicalDfa.alphabet.end()), canonicalDfa.alphabet.end());
+
+    return canonicalDfa;
+};
@@ -0,0 +1,63 @@
+#ifndef INDEXED_AUTOMATA_HPP
+#define INDEXED_AUTOMATA_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "finite_automata.hpp"
+
+// subset states are sorted vectors of state indexes
+template <>
+struct std::hash<std::vector<int>> {
+    size_t operator()(const std::vector<int>& subset) const;
+};
+
+// a FiniteAutomata compiled down to integer states, for algorithms that explore subset states lazily instead of building a dfa
+class IndexedAutomata
+{
+    private:
+        // visit marks for closures, a state is marked when its mark equals the current generation
+        std::vector<int> marks;
+        int markGeneration = 0;
+
+        IndexedAutomata() = default;
+
+    public:
+        std::vector<std::string> stateNames;
+
+        int startState;
+        std::vector<bool> acceptingStates;
+
+        // every letter used on an edge, sorted
+        std::vector<char> alphabet;
+
+        // [state] = [letter, end state] sorted by letter
+        std::vector<std::vector<std::pair<char, int>>> transitions;
+
+        // [state] = end states of its λ edges
+        std::vector<std::vector<int>> lambdaTransitions;
+
+        IndexedAutomata(FiniteAutomata fa);
+
+        int getStateCount();
+
+        // closes the given states under λ moves, the result is sorted
+        std::vector<int> closure(std::vector<int> states);
+
+        std::vector<int> getStartSubset();
+
+        // closed subset reached from a closed subset by reading c, empty when c leads nowhere
+        std::vector<int> step(const std::vector<int>& subset, char c);
+
+        bool isAccepting(const std::vector<int>& subset);
+
+        // reachable part of the subset construction, without λ edges or the dead (empty) subset
+        IndexedAutomata determinize();
+
+        // minimal dfa without dead states, numbered in bfs order from the start state taking letters in sorted order
+        // two automata with the same language produce identical canonical forms, the alphabet only keeps letters that still appear
+        IndexedAutomata canonicalize();
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include <limits>
+
+#include "lexical_scanner.hpp"
+#include "finite_automata.hpp"
+#include "indexed_automata.hpp"
+
+// lowering
+
+std::bitset<256> LexicalScanner::Lowering::getContinuationSet(RegularExpression re)
+{
+    // every state of the min dfa can still reach an accepting state, so any byte read from an accepting state extends some match
+    IndexedAutomata dfa(FiniteAutomata::re2dfa(re).dfa2minDfa());
+
+    std::bitset<256> continuationSet;
+
+    for (int state = 0;state<dfa.getStateCount();state++) {
+        if (!dfa.acceptingStates[state]) continue;
+
+        for (auto [letter, endState] : dfa.transitions[state]) continuationSet.set((unsigned char) letter);
+    }
+
+    return continuationSet;
+};
+
+std::optional<RegularExpression> LexicalScanner::Lowering::lower(const ParserCombinator& tokenGenerator)
+{
+    auto& shape = tokenGenerator.getShape();
+
+    if (shape == nullptr) return std::nullopt;
+
+    // grammars share sub combinators, so each shape is only lowered (and checked) once
+    auto loweredShape = this->loweredShapes.find(shape.get());
+
+    if (loweredShape != this->loweredShapes.end()) return loweredShape->second;
+
+    auto re = this->lowerShape(*shape);
+
+    this->loweredShapes[shape.get()] = re;
+
+    return re;
+};
+
+std::optional<RegularExpression> LexicalScanner::Lowering::lowerShape(const ParserCombinatorShape& shape)
+{
+    auto& context = this->context;
+
+    // satisfy matches the terminating null at the end of the input, which the scanner never reads
+    if (shape.type == ParserCombinatorShape::SATISFY) {
+        auto& bytes = shape.charClass.getBytes();
+
+        if (bytes.none() || bytes.test(0)) return std::nullopt;
+
+        std::optional<RegularExpression> re;
+
+        for (int c = 255;c>0;c--) {
+            if (!bytes.test(c)) continue;
+
+            auto characterRe = RegularExpression::character(context, (char) c);
+
+            re = re ? RegularExpression::plus(characterRe, *re) : characterRe;
+        }
+
+        return re;
+    }
+
+    if (shape.type == ParserCombinatorShape::STRING) {
+        if (shape.stringLiteral.find('\0') != std::string::npos) return std::nullopt;
+
+        auto re = RegularExpression::empty(context);
+
+        for (int i = shape.stringLiteral.size() - 1;i>=0;i--) re = RegularExpression::concat(RegularExpression::character(context, shape.stringLiteral[i]), re);
+
+        return re;
+    }
+
+    std::vector<RegularExpression> childRes;
+
+    for (auto& child : shape.children) {
+        auto childRe = this->lower(child);
+
+        if (!childRe) return std::nullopt;
+
+        childRes.push_back(*childRe);
+    }
+
+    // choice takes the longest alternative, which is already the longest match of the union
+    if (shape.type == ParserCombinatorShape::CHOICE) {
+        if (childRes.empty()) return std::nullopt;
+
+        auto re = childRes.back();
+
+        for (int i = childRes.size() - 2;i>=0;i--) re = RegularExpression::plus(childRes[i], re);
+
+        return re;
+    }
+
+    // a sequence never gives back what an element matched, so that only agrees with the longest match
+    // when no byte that could extend an element can also start the rest of the sequence
+    if (shape.type == ParserCombinatorShape::SEQUENCE) {
+        std::bitset<256> restFirstSet;
+
+        for (int i = shape.children.size() - 1;i>=0;i--) {
+            if (i != shape.children.size() - 1 && (this->getContinuationSet(childRes[i]) & restFirstSet).any()) return std::nullopt;
+
+            if (!shape.children[i].isNullable()) restFirstSet.reset();
+
+            restFirstSet |= shape.children[i].getFirstSet();
+        }
+
+        auto re = RegularExpression::empty(context);
+
+        for (int i = childRes.size() - 1;i>=0;i--) re = RegularExpression::concat(childRes[i], re);
+
+        return re;
+    }
+
+    // repetition, the same argument as a sequence of the nested combinator with itself
+    auto& nestedTokenGenerator = shape.children[0];
+    auto nestedRe = childRes[0];
+
+    bool isUnbounded = shape.maxCount == std::numeric_limits<int>::max();
+
+    // counted repetitions are unrolled, so large counts are left to the combinator
+    if (shape.minCount > 64 || (!isUnbounded && shape.maxCount > 64)) return std::nullopt;
+
+    // a repetition stops at an empty match without counting it, so a nullable nested combinator can fail where its language would not
+    if (nestedTokenGenerator.isNullable() && shape.minCount > 0) return std::nullopt;
+
+    if ((isUnbounded || shape.maxCount > 1) && (this->getContinuationSet(nestedRe) & nestedTokenGenerator.getFirstSet()).any()) return std::nullopt;
+
+    auto re = isUnbounded ? RegularExpression::star(nestedRe) : RegularExpression::empty(context);
+
+    if (!isUnbounded) for (int i = shape.minCount;i<shape.maxCount;i++) re = RegularExpression::concat(RegularExpression::plus(nestedRe, RegularExpression::empty(context)), re);
+
+    for (int i = 0;i<shape.minCount;i++) re = RegularExpression::concat(nestedRe, re);
+
+    return re;
+};
+
+// lexical scanner
+
+std::optional<LexicalScanner> LexicalScanner::compile(const ParserCombinator& tokenGenerator)
+{
+    // the expressions are only needed until the dfa is built
+    RegularExpressionContext context;
+
+    auto re = Lowering(context).lower(tokenGenerator);
+
+    if (!re) return std::nullopt;
+
+    IndexedAutomata dfa(FiniteAutomata::re2dfa(*re).dfa2minDfa());
+
+    int stateCount = dfa.getStateCount();
+
+    // states that can no longer reach an accepting state are dropped, so the scan stops as soon as no longer match is possible
+    std::vector<std::vector<int>> invertedTransitions(stateCount);
+
+    for (int state = 0;state<stateCount;state++) {
+        for (auto [letter, endState] : dfa.transitions[state]) invertedTransitions[endState].push_back(state);
+    }
+
+    std::vector<bool> liveStates = dfa.acceptingStates;
+    std::vector<int> stack;
+
+    for (int state = 0;state<stateCount;state++) if (liveStates[state]) stack.push_back(state);
+
+    while (!stack.empty()) {
+        int state = stack.back();
+
+        stack.pop_back();
+
+        for (auto startState : invertedTransitions[state]) {
+            if (liveStates[startState]) continue;
+
+            liveStates[startState] = true;
+            stack.push_back(startState);
+        }
+    }
+
+    LexicalScanner scanner;
+
+    scanner.startState = dfa.startState;
+    scanner.acceptingStates = dfa.acceptingStates;
+    scanner.transitions.resize(stateCount);
+
+    for (int state = 0;state<stateCount;state++) {
+        scanner.transitions[state].fill(-1);
+
+        for (auto [letter, endState] : dfa.transitions[state]) if (liveStates[endState]) scanner.transitions[state][(unsigned char) letter] = endState;
+    }
+
+    return scanner;
+};
+
+int LexicalScanner::match(const std::string& str, const int start) const
+{
+    int state = this->startState;
+
+    int longestWidth = this->acceptingStates[state] ? 0 : -1;
+
+    for (int i = start;i<(int) str.size();i++) {
+        state = this->transitions[state][(unsigned char) str[i]];
+
+        if (state == -1) break;
+
+        if (this->acceptingStates[state]) longestWidth = i - start + 1;
+    }
+
+    return longestWidth;
+};
+
+int LexicalScanner::getStateCount() const
+{
+    return this->transitions.size();
+};
+
+// lexical
+
+ParserCombinator lexical(const ParserCombinator tokenGenerator)
+{
+    return lexical("", tokenGenerator);
+};
+
+ParserCombinator lexical(const std::string tokenId, const ParserCombinator tokenGenerator)
+{
+    int kind = Token::internKind(tokenId);
+
+    auto scanner = LexicalScanner::compile(tokenGenerator);
+
+    return ParserCombinator([kind, tokenGenerator, scanner] (const std::string& str, const int start) -> ParserCombinatorResult {
+        if (scanner) {
+            int width = scanner->match(str, start);
+
+            if (width != -1) return Token::span(kind, str, start, width);
+        }
+
+        ParserCombinatorResult result = tokenGenerator(str, start);
+
+        if (getResultType(result) == ParserCombinatorResultType::PARSER_FAILURE) return result;
+
+        return Token::span(kind, str, start, std::get<Token>(result).width);
+    }).withFirstSet(tokenGenerator.getFirstSet(), tokenGenerator.isNullable()).withShape(tokenGenerator.getShape());
+};
@@ -0,0 +1,61 @@
+#ifndef LEXICAL_SCANNER_HPP
+#define LEXICAL_SCANNER_HPP
+
+#include <string>
+#include <vector>
+#include <array>
+#include <bitset>
+#include <optional>
+#include <unordered_map>
+
+#include "../lib/parser.hpp"
+#include "regular_expression.hpp"
+
+// a regular sub grammar compiled to a min dfa, run over a dense transition table
+class LexicalScanner
+{
+    private:
+        // [state][byte] = next state, -1 where the dfa dies
+        std::vector<std::array<int, 256>> transitions;
+        std::vector<bool> acceptingStates;
+
+        int startState = 0;
+
+        LexicalScanner() = default;
+
+        // lowers one combinator into the context, nullopt when it is not regular or greedy matching could differ from longest matching
+        class Lowering
+        {
+            private:
+                RegularExpressionContext& context;
+
+                std::unordered_map<const ParserCombinatorShape*, std::optional<RegularExpression>> loweredShapes;
+
+                // bytes that can extend a match of re into a longer match
+                std::bitset<256> getContinuationSet(RegularExpression re);
+
+                std::optional<RegularExpression> lowerShape(const ParserCombinatorShape& shape);
+
+            public:
+                Lowering(RegularExpressionContext& context): context(context) {};
+
+                std::optional<RegularExpression> lower(const ParserCombinator& tokenGenerator);
+        };
+
+    public:
+        // nullopt unless the combinator is built only from satisfy of a CharClass, string, sequence, choice and repetition
+        // and each sequence or repetition provably matches the same length greedily as the longest match of its language
+        static std::optional<LexicalScanner> compile(const ParserCombinator& tokenGenerator);
+
+        // length of the longest prefix of str from start the grammar accepts, -1 when there is none
+        int match(const std::string& str, const int start) const;
+
+        int getStateCount() const;
+};
+
+// matches what tokenGenerator matches, as a single literal token of the matched text
+// runs as a dfa when LexicalScanner can compile tokenGenerator and falls back to tokenGenerator otherwise, failures always come from tokenGenerator
+ParserCombinator lexical(const ParserCombinator tokenGenerator);
+ParserCombinator lexical(const std::string tokenId, const ParserCombinator tokenGenerator);
+
+#endif
@@ -1,71 +1,346 @@
 #include <fstream>
+#include <sstream>
 #include <cstdlib>
 #include <filesystem>
+#include <thread>
 
 #include "regular_expression.hpp"
+#include "regular_expression_simplifier.hpp"
+#include "regular_expression_parser.hpp"
+
+// expression context
+
+size_t std::hash<RegularExpressionNodeKey>::operator()(const RegularExpressionNodeKey& key) const
+{
+    // operands are already unique, so hashing their addresses is enough to find them in the table
+    size_t hash = key.type * 257 + (unsigned char) key.character;
+
+    hash = hash * 1000003 ^ std::hash<const RegularExpressionNode*>()(key.operand1);
+    hash = hash * 1000003 ^ std::hash<const RegularExpressionNode*>()(key.operand2);
+
+    return hash;
+};
+
+RegularExpressionContext& RegularExpressionContext::global()
+{
+    // never destroyed, since expressions held by other statics can still be used during static destruction
+    static auto globalContext = new RegularExpressionContext();
+
+    return *globalContext;
+};
+
+RegularExpressionContext::Shard& RegularExpressionContext::getShard(const RegularExpressionNodeKey& key)
+{
+    return this->shards[std::hash<RegularExpressionNodeKey>()(key) % this->shards.size()];
+};
+
+RegularExpression RegularExpressionContext::intern(RegularExpressionType type, char character, const RegularExpressionNode* operand1, const RegularExpressionNode* operand2)
+{
+    RegularExpressionNodeKey key = { type, character, operand1, operand2 };
+
+    auto& shard = this->getShard(key);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto existingNode = shard.uniqueTable.find(key);
+
+    if (existingNode != shard.uniqueTable.end()) return RegularExpression(existingNode->second);
+
+    // bump allocate, chunks double in size so there are only ever log(n) allocations
+    if (shard.chunkSize == shard.chunkCapacity) {
+        shard.chunkCapacity = shard.chunkCapacity == 0 ? 64 : std::min(shard.chunkCapacity * 2, 1 << 16);
+        shard.chunkSize = 0;
+
+        shard.chunks.push_back(std::make_unique<RegularExpressionNode[]>(shard.chunkCapacity));
+    }
+
+    RegularExpressionNode* node = &shard.chunks.back()[shard.chunkSize++];
+
+    node->type = type;
+    node->character = character;
+    node->operand1 = operand1;
+    node->operand2 = operand2;
+
+    node->nodeCount = 1 + (operand1 ? operand1->nodeCount : 0) + (operand2 ? operand2->nodeCount : 0);
+
+    node->hash = type * 257 + (unsigned char) character;
+    if (operand1) node->hash = node->hash * 1000003 ^ operand1->hash;
+    if (operand2) node->hash = node->hash * 1000003 ^ operand2->hash;
+
+    node->context = this;
+
+    shard.uniqueTable[key] = node;
+
+    return RegularExpression(node);
+};
+
+size_t RegularExpressionContext::nodeCount()
+{
+    size_t nodeCount = 0;
+
+    for (auto& shard : this->shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        nodeCount += shard.uniqueTable.size();
+    }
+
+    return nodeCount;
+};
+
+void RegularExpressionContext::reset()
+{
+    for (auto& shard : this->shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        shard.uniqueTable.clear();
+        shard.chunks.clear();
+        shard.chunkCapacity = 0;
+        shard.chunkSize = 0;
+    }
+};
+
+// regular expression
+
+RegularExpression::RegularExpression(const RegularExpressionNode* node): node(node) {};
 
 RegularExpression RegularExpression::empty()
 {
-    return RegularExpression(RegularExpressionType::EMPTY, {});
+    return RegularExpression::empty(RegularExpressionContext::global());
 };
 
 RegularExpression RegularExpression::character(char c)
 {
-    return RegularExpression(RegularExpressionType::CHARACTER, c);
+    return RegularExpression::character(RegularExpressionContext::global(), c);
+};
+
+RegularExpression RegularExpression::empty(RegularExpressionContext& context)
+{
+    return context.intern(RegularExpressionType::EMPTY, '\0', nullptr, nullptr);
+};
+
+RegularExpression RegularExpression::character(RegularExpressionContext& context, char c)
+{
+    return context.intern(RegularExpressionType::CHARACTER, c, nullptr, nullptr);
 };
 
 RegularExpression RegularExpression::concat(RegularExpression re1, RegularExpression re2)
 {
-    if (re1.type == EMPTY) return re2;
-    if (re2.type == EMPTY) return re1;
+    if (re1.getType() == EMPTY) return re2;
+    if (re2.getType() == EMPTY) return re1;
 
-    return RegularExpression(RegularExpressionType::CONCAT, std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> {
-        std::make_shared<RegularExpression>(re1),
-        std::make_shared<RegularExpression>(re2)
-    });
+    if (re1.node->context != re2.node->context) throw std::runtime_error("RegularExpression concat: operands belong to different contexts");
+
+    return re1.node->context->intern(RegularExpressionType::CONCAT, '\0', re1.node, re2.node);
 };
 
 RegularExpression RegularExpression::plus(RegularExpression re1, RegularExpression re2)
 {
-    return RegularExpression(RegularExpressionType::PLUS, std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> {
-        std::make_shared<RegularExpression>(re1),
-        std::make_shared<RegularExpression>(re2)
-    });
+    if (re1.node->context != re2.node->context) throw std::runtime_error("RegularExpression plus: operands belong to different contexts");
+
+    return re1.node->context->intern(RegularExpressionType::PLUS, '\0', re1.node, re2.node);
 };
 
 RegularExpression RegularExpression::star(RegularExpression re)
 {
-    return RegularExpression(RegularExpressionType::STAR, std::make_shared<RegularExpression>(re));
+    return re.node->context->intern(RegularExpressionType::STAR, '\0', re.node, nullptr);
 };
 
 RegularExpression RegularExpression::fromToken(Token token)
 {
-    if (token.id == "CHAR") return RegularExpression::character(token.getStringLiteralContent()[0]);
+    return RegularExpression::fromToken(RegularExpressionContext::global(), token);
+};
+
+// joins operands pairwise level by level, so an n-ary chain becomes a tree of depth log n instead of n
+static RegularExpression buildBalanced(std::vector<RegularExpression> operands, RegularExpression (*combine)(RegularExpression, RegularExpression))
+{
+    while (operands.size() > 1) {
+        std::vector<RegularExpression> combinedOperands;
+
+        for (int i = 0;i + 1<operands.size();i += 2) combinedOperands.push_back(combine(operands[i], operands[i + 1]));
+
+        if (operands.size() % 2 == 1) combinedOperands.push_back(operands.back());
+
+        operands = combinedOperands;
+    }
+
+    return operands[0];
+};
+
+RegularExpression RegularExpression::fromToken(RegularExpressionContext& context, Token token)
+{
+    // post order traversal with an explicit stack, [token, children already visited]
+
+    static const int charKind = Token::internKind("CHAR");
+    static const int concatKind = Token::internKind("CONCAT");
+    static const int plusKind = Token::internKind("PLUS");
+    static const int starKind = Token::internKind("STAR");
+
+    std::vector<RegularExpression> resultStack;
+
+    std::vector<std::pair<const Token*, bool>> traversalStack = { { &token, false } };
+
+    while (!traversalStack.empty()) {
+        auto [currentToken, isExpanded] = traversalStack.back();
+
+        traversalStack.pop_back();
+
+        if (currentToken->kind == charKind) {
+            resultStack.push_back(RegularExpression::character(context, currentToken->getStringLiteralContent()[0]));
+
+            continue;
+        }
+
+        bool isOperator = currentToken->kind == concatKind || currentToken->kind == plusKind || currentToken->kind == starKind;
+
+        if (!isOperator) {
+            resultStack.push_back(RegularExpression::empty(context));
+
+            continue;
+        }
+
+        auto children = currentToken->getNestingContent();
+
+        if (!isExpanded) {
+            traversalStack.push_back({ currentToken, true });
+
+            for (int i = children.size() - 1;i>=0;i--) traversalStack.push_back({ &children[i], false });
+
+            continue;
+        }
+
+        if (currentToken->kind == starKind) {
+            resultStack.back() = RegularExpression::star(resultStack.back());
+
+            continue;
+        }
+
+        // concat and plus tokens are n-ary chains
+        std::vector<RegularExpression> operands(resultStack.end() - children.size(), resultStack.end());
+
+        resultStack.erase(resultStack.end() - children.size(), resultStack.end());
+
+        resultStack.push_back(buildBalanced(operands, currentToken->kind == concatKind ? RegularExpression::concat : RegularExpression::plus));
+    }
+
+    return resultStack.back();
+};
+
+RegularExpression RegularExpression::fromExpressionString(std::string_view expressionStr)
+{
+    return RegularExpression::fromExpressionString(RegularExpressionContext::global(), expressionStr);
+};
+
+RegularExpression RegularExpression::fromExpressionString(RegularExpressionContext& context, std::string_view expressionStr)
+{
+    // builds the same tree as parsing with RegularExpressionGrammar and then calling fromToken, in one pass
+    auto parseResult = RegularExpressionParser(context).parse(expressionStr);
+
+    if (std::holds_alternative<ParserFailure>(parseResult)) throw std::runtime_error("RegularExpression fromExpressionString: " + std::get<ParserFailure>(parseResult).toString());
+
+    return std::get<RegularExpression>(parseResult);
+};
+
+std::vector<RegularExpression> RegularExpression::fromExpressionStrings(const std::vector<std::string>& expressionStrs)
+{
+    return RegularExpression::fromExpressionStrings(RegularExpressionContext::global(), expressionStrs);
+};
+
+std::vector<RegularExpression> RegularExpression::fromExpressionStrings(RegularExpressionContext& context, const std::vector<std::string>& expressionStrs)
+{
+    int expressionCount = expressionStrs.size();
+
+    std::vector<RegularExpression> expressions(expressionCount);
+
+    // the failure of each expression, so the first one by index is reported no matter which thread got there first
+    std::vector<std::string> failures(expressionCount);
+
+    int threadCount = std::max(1, std::min((int) std::thread::hardware_concurrency(), expressionCount));
+
+    std::vector<std::thread> threads;
+
+    for (int threadIndex = 0;threadIndex<threadCount;threadIndex++) {
+        threads.emplace_back([&context, &expressionStrs, &expressions, &failures, expressionCount, threadIndex, threadCount] () {
+            RegularExpressionParser parser(context);
+
+            for (int expressionIndex = threadIndex;expressionIndex<expressionCount;expressionIndex += threadCount) {
+                auto parseResult = parser.parse(expressionStrs[expressionIndex]);
+
+                if (std::holds_alternative<ParserFailure>(parseResult)) failures[expressionIndex] = std::get<ParserFailure>(parseResult).toString();
+
+                else expressions[expressionIndex] = std::get<RegularExpression>(parseResult);
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+
+    for (int expressionIndex = 0;expressionIndex<expressionCount;expressionIndex++) {
+        if (!failures[expressionIndex].empty()) throw std::runtime_error("RegularExpression fromExpressionStrings: expression " + std::to_string(expressionIndex) + ": " + failures[expressionIndex]);
+    }
+
+    return expressions;
+};
+
+RegularExpressionContext& RegularExpression::getContext() const
+{
+    return *this->node->context;
+};
 
-    std::vector<RegularExpression> nestedExpressions;
-    for (auto nestedToken : token.getNestingContent()) nestedExpressions.push_back(RegularExpression::fromToken(nestedToken));
+RegularExpressionType RegularExpression::getType() const
+{
+    return this->node->type;
+};
 
-    if (token.id == "CONCAT") return RegularExpression::concat(nestedExpressions[0], nestedExpressions[1]);
+char RegularExpression::getCharacterExpression() const
+{
+    return this->node->character;
+};
 
-    if (token.id == "PLUS") return RegularExpression::plus(nestedExpressions[0], nestedExpressions[1]);
-    
-    if (token.id == "STAR") return RegularExpression::star(nestedExpressions[0]);
+std::pair<RegularExpression, RegularExpression> RegularExpression::getConcatExpression() const
+{
+    return { RegularExpression(this->node->operand1), RegularExpression(this->node->operand2) };
+};
+
+std::pair<RegularExpression, RegularExpression> RegularExpression::getPlusExpression() const
+{
+    return { RegularExpression(this->node->operand1), RegularExpression(this->node->operand2) };
+};
 
-    return RegularExpression::empty();
+RegularExpression RegularExpression::getStarExpression() const
+{
+    return RegularExpression(this->node->operand1);
 };
 
-RegularExpression RegularExpression::fromExpressionString(std::string expressionStr)
+size_t RegularExpression::size() const
 {
-    // uses parser lib to construct expression tree from a re string, then pass to fromToken to build actual re
+    return this->node->nodeCount;
+};
 
+size_t RegularExpression::hash() const
+{
+    return this->node->hash;
+};
+
+RegularExpression RegularExpression::simplify() const
+{
+    return this->simplify(ALL_SIMPLIFICATION_RULES);
+};
+
+RegularExpression RegularExpression::simplify(int rules) const
+{
+    return RegularExpressionSimplifier(rules).simplify(*this);
+};
+
+// expression grammar
+
+RegularExpressionGrammar::RegularExpressionGrammar()
+{
     // combinators are a bit tricky here since it has to avoid left recursion
     // to do this we use atomic expressions which dont self recurse and then build recursive operational expressions layer by layer
 
-    ParserCombinator expression;
-    
     auto whitespace = repetition(satisfy(is(' ')));
 
-    auto characterExpression = satisfy("CHAR", isalnum);
+    auto characterExpression = satisfy("CHAR", CharClass(isalnum));
 
     // λ
     auto lambdaExpression = sequence("EMPTY", {
@@ -73,9 +348,10 @@ RegularExpression RegularExpression::fromExpressionString(std::string expression
         satisfy(is((char) 187))
     });
 
+    // star and plain atoms both start by parsing an atom, so without memoization a group nested n deep is parsed 2^n times
     auto groupExpression = sequence({
         satisfy(is('(')),
-        proxyParserCombinator(&expression),
+        proxyParserCombinator(&this->expression).memoized(),
         satisfy(is(')'))
     });
 
@@ -92,157 +368,166 @@ RegularExpression RegularExpression::fromExpressionString(std::string expression
         atom
     });
 
-    ParserCombinator concatExpression = sequence("CONCAT", {
-        atomOrStarExpression,
-        whitespace,
-        choice({
-            proxyParserCombinator(&concatExpression),
-            atomOrStarExpression
-        })
-    });
-
-    ParserCombinator plusExpression = sequence("PLUS", {
-        choice({
-            concatExpression,
-            atomOrStarExpression
-        }),
-        satisfy(is('+')).surroundedBy(whitespace),
-        choice({
-            proxyParserCombinator(&plusExpression),
-            concatExpression,
-            atomOrStarExpression
-        })
-    });
+    // chains are parsed flat with repetition rather than by recursing on the rest of the chain
+    // so a long alternation costs neither stack depth nor backtracking
 
-    expression = choice({
-        plusExpression,
-        concatExpression,
-        starExpression,
-        atom
-    }).surroundedBy(whitespace);
+    auto concatExpression = atomOrStarExpression.repeatedlyWithDelimeter("CONCAT", whitespace);
 
-    auto grammar = strictlySequence({
-        expression,
-        satisfy(is('\0'))
-    });
-    
-    auto parseResult = parse(expressionStr + '\0', grammar);
+    auto plusExpression = concatExpression.repeatedlyWithDelimeter("PLUS", satisfy(is('+')).surroundedBy(whitespace));
 
-    if (getResultType(parseResult) == PARSER_FAILURE) throw std::runtime_error("RegularExpression fromExpressionString: " + getParserFailureFromResult(parseResult).toString());
+    this->expression = plusExpression.surroundedBy(whitespace);
 
-    return RegularExpression::fromToken(getTokenFromResult(parseResult).getNestingContent()[0]);
+    // strictly consuming the whole input ends the parse, no terminating character is needed
+    this->grammar = strictlySequence({
+        this->expression
+    });
 };
 
-RegularExpressionType RegularExpression::getType()
+const RegularExpressionGrammar& RegularExpressionGrammar::get()
 {
-    return this->type;
-};
+    // built on first use, static initialization is thread safe
+    static const RegularExpressionGrammar grammar;
 
-char RegularExpression::getCharacterExpression()
-{
-    return std::get<char>(this->value);
+    return grammar;
 };
 
-std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> RegularExpression::getConcatExpression()
+ParserCombinatorResult RegularExpressionGrammar::parse(std::string_view expressionStr) const
 {
-    return std::get<std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>>>(this->value);
+    return ::parse(std::string(expressionStr), this->grammar);
 };
 
-std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> RegularExpression::getPlusExpression()
+size_t std::hash<RegularExpression>::operator()(const RegularExpression& re) const
 {
-    return std::get<std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>>>(this->value);
+    return re.hash();
 };
 
-std::shared_ptr<RegularExpression> RegularExpression::getStarExpression()
+void RegularExpression::emit(std::ostream& output, bool isLatex)
 {
-    return std::get<std::shared_ptr<RegularExpression>>(this->value);
-};
+    // pre order traversal with an explicit stack, each entry is either an expression to expand or a literal to write
+    // literals are pushed around operands in reverse so everything pops in output order
 
-std::string RegularExpression::toString()
-{
-    if (this->type == EMPTY) return "λ";
+    std::vector<std::pair<RegularExpression, const char*>> stack = { { *this, nullptr } };
 
-    if (this->type == CHARACTER) return std::string(1, std::get<char>(this->value));
+    while (!stack.empty()) {
+        auto [currentRe, literal] = stack.back();
 
-    if (this->type == STAR) {
-        auto operand = std::get<std::shared_ptr<RegularExpression>>(this->value);
+        stack.pop_back();
 
-        auto operandString = operand->toString();
+        if (literal != nullptr) {
+            output << literal;
 
-        if (operand->getType() == PLUS || operand->getType() == CONCAT) operandString = "(" + operandString + ")";
+            continue;
+        }
 
-        return operandString + "*";
-    }
+        auto type = currentRe.getType();
 
-    auto operands = std::get<std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>>>(this->value);
+        if (type == EMPTY) output << (isLatex ? "\\lambda" : "λ");
 
-    auto leftOperandString = operands.first->toString();
-    auto rightOperandString = operands.second->toString();
+        else if (type == CHARACTER) {
+            char c = currentRe.getCharacterExpression();
 
-    if (this->type == PLUS) return leftOperandString + "+" + rightOperandString;
-    
-    // if either operand comes from a plus, it needs to be wrapped before concat to ensure correct distribution
+            if (!isLatex) output << c;
+            else if (c == '\\') output << "\\textbackslash{}";
+            else if (
+                c == '{' ||
+                c == '}' ||
+                c == '_' ||
+                c == '^' ||
+                c == '$' ||
+                c == '&' ||
+                c == '#' ||
+                c == '%' ||
+                c == '~'
+            ) output << '\\' << c;
+            else output << c;
+        }
+
+        else if (type == STAR) {
+            auto operand = currentRe.getStarExpression();
+
+            bool isWrapped = operand.getType() == PLUS || operand.getType() == CONCAT;
+
+            stack.push_back({ RegularExpression(), isLatex ? "^*" : "*" });
+
+            if (isWrapped) stack.push_back({ RegularExpression(), ")" });
+
+            stack.push_back({ operand, nullptr });
+
+            if (isWrapped) stack.push_back({ RegularExpression(), "(" });
+        }
+
+        else if (type == PLUS) {
+            auto [leftOperand, rightOperand] = currentRe.getPlusExpression();
+
+            stack.push_back({ rightOperand, nullptr });
+            stack.push_back({ RegularExpression(), "+" });
+            stack.push_back({ leftOperand, nullptr });
+        }
+
+        else {
+            auto [leftOperand, rightOperand] = currentRe.getConcatExpression();
+
+            // if either operand comes from a plus, it needs to be wrapped before concat to ensure correct distribution
+
+            for (auto operand : { rightOperand, leftOperand }) {
+                bool isWrapped = operand.getType() == PLUS;
+
+                if (isWrapped) stack.push_back({ RegularExpression(), ")" });
+
+                stack.push_back({ operand, nullptr });
 
-    if (operands.first->getType() == PLUS) leftOperandString = "(" + leftOperandString + ")";
-    if (operands.second->getType() == PLUS) rightOperandString = "(" + rightOperandString + ")";
+                if (isWrapped) stack.push_back({ RegularExpression(), "(" });
+            }
+        }
+    }
+};
+
+std::string RegularExpression::toString()
+{
+    std::ostringstream output;
+
+    this->toString(output);
 
-    return leftOperandString + rightOperandString;
+    return output.str();
+};
+
+void RegularExpression::toString(std::ostream& output)
+{
+    this->emit(output, false);
 };
 
 std::string RegularExpression::toLatex()
 {
-    std::string output;
+    std::ostringstream output;
 
-    output += "\\documentclass[border=10pt]{standalone}";
+    this->toLatex(output);
 
-    output += "\n";
+    return output.str();
+};
 
-    output += "\\usepackage{amsmath}";
+void RegularExpression::toLatex(std::ostream& output)
+{
+    output << "\\documentclass[border=10pt]{standalone}";
 
-    output += "\n";
+    output << "\n";
 
-    output += "\\begin{document}";
+    output << "\\usepackage{amsmath}";
 
-    output += "\n";
+    output << "\n";
 
-    std::string raw = this->toString();
-    std::string escaped;
-    
-    while (!raw.empty()) {
-        if (raw.starts_with("λ")) {
-            escaped += "\\lambda";
-            
-            raw.erase(raw.begin(), raw.begin() + std::string("λ").size());
-        }
-        else {
-            char c = raw.front();
+    output << "\\begin{document}";
 
-            if (c == '\\') escaped += "\\textbackslash{}";
-            else if (
-                c == '{' ||
-                c == '}' ||
-                c == '_' ||
-                c == '^' ||
-                c == '$' ||
-                c == '&' ||
-                c == '#' ||
-                c == '%' ||
-                c == '~'
-            ) escaped += "\\" + std::string(c, 1);
-            else if(c == '*') escaped += "^*";
-            else escaped += c;
+    output << "\n";
 
-            raw.erase(raw.begin());
-        }
-    }
+    output << "$ ";
 
-    output += "$ " + escaped + " $";
+    this->emit(output, true);
 
-    output += "\n";
+    output << " $";
 
-    output += "\\end{document}";
+    output << "\n";
 
-    return output;
+    output << "\\end{document}";
 };
 
 void RegularExpression::exportExpression(std::string outputDirPath, std::string outputFileName)
@@ -254,7 +539,7 @@ void RegularExpression::exportExpression(std::string outputDirPath, std::string
     std::string pngOutputFilePath = outputDirPath + "/" + outputFileName + ".png";
 
     std::ofstream latexOutputFile(latexOutputFilePath);
-    latexOutputFile << this->toLatex();
+    this->toLatex(latexOutputFile);
     latexOutputFile.close();
 
     std::string renderLaTeXCommand = 
@@ -2,8 +2,12 @@
 #define REGULAR_EXPRESSION_HPP
 
 #include <unordered_map>
-#include <variant>
+#include <vector>
+#include <array>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
 
 #include "../lib/parser.hpp"
 
@@ -16,52 +20,192 @@ enum RegularExpressionType
     STAR
 };
 
+// rewrite rules for RegularExpression::simplify, combined as a bit mask
+enum SimplificationRule
+{
+    IDEMPOTENT_PLUS     = 1 << 0, // x + x = x
+    STAR_OF_STAR        = 1 << 1, // (x*)* = x*, (x* + y)* = (x + y)*
+    LAMBDA_ABSORPTION   = 1 << 2, // λ* = λ, λ + x* = x*, (λ + x)* = x*
+    FACTOR_PREFIX       = 1 << 3, // xy + xz = x(y + z)
+    FACTOR_SUFFIX       = 1 << 4, // yx + zx = (y + z)x
+    FLATTEN_ASSOCIATIVE = 1 << 5, // (x + y) + z = x + (y + z), (xy)z = x(yz), so the other rules see whole chains
+
+    ALL_SIMPLIFICATION_RULES = (1 << 6) - 1
+};
+
+class RegularExpressionNode;
+class RegularExpressionContext;
+
 class RegularExpression
 {
     private:
-        RegularExpressionType type;
-        
-        std::variant<
-            std::monostate,
-            char,
-            std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>>,
-            std::shared_ptr<RegularExpression>
-        > value;
-
-        RegularExpression(
-            RegularExpressionType type,
-            std::variant<
-                std::monostate,
-                char,
-                std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>>,
-                std::shared_ptr<RegularExpression>
-            > value
-        ): type(type), value(value) {};
+        // expressions are hash consed within their context, so structurally equal expressions always share the same node
+        // nodes are owned by the context, so copying an expression is copying a pointer
+        // a RegularExpression is only valid until its context is destroyed or reset
+        const RegularExpressionNode* node = nullptr;
+
+        RegularExpression(const RegularExpressionNode* node);
+
+        friend class RegularExpressionContext;
+
+        // shared single pass emitter for toString and toLatex
+        void emit(std::ostream& output, bool isLatex);
 
     public:
         RegularExpression() = default;
 
+        // these build in the global context, which lives for the whole program
         static RegularExpression empty();
         static RegularExpression character(char c);
+
+        static RegularExpression empty(RegularExpressionContext& context);
+        static RegularExpression character(RegularExpressionContext& context, char c);
+
+        // these build in the context of their operands
         static RegularExpression concat(RegularExpression re1, RegularExpression re2);
         static RegularExpression plus(RegularExpression re1, RegularExpression re2);
         static RegularExpression star(RegularExpression re);
 
         static RegularExpression fromToken(Token token);
+        static RegularExpression fromToken(RegularExpressionContext& context, Token token);
+
+        static RegularExpression fromExpressionString(std::string_view expressionStr);
+        static RegularExpression fromExpressionString(RegularExpressionContext& context, std::string_view expressionStr);
+
+        // parses on every hardware thread, the results line up with expressionStrs
+        static std::vector<RegularExpression> fromExpressionStrings(const std::vector<std::string>& expressionStrs);
+        static std::vector<RegularExpression> fromExpressionStrings(RegularExpressionContext& context, const std::vector<std::string>& expressionStrs);
+
+        RegularExpressionContext& getContext() const;
+
+        RegularExpressionType getType() const;
+
+        char getCharacterExpression() const;
+        std::pair<RegularExpression, RegularExpression> getConcatExpression() const;
+        std::pair<RegularExpression, RegularExpression> getPlusExpression() const;
+        RegularExpression getStarExpression() const;
 
-        static RegularExpression fromExpressionString(std::string expressionStr);
+        size_t size() const;
 
-        RegularExpressionType getType();
+        // structural hash, independent of where the nodes live
+        size_t hash() const;
 
-        char getCharacterExpression();
-        std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> getConcatExpression();
-        std::pair<std::shared_ptr<RegularExpression>, std::shared_ptr<RegularExpression>> getPlusExpression();
-        std::shared_ptr<RegularExpression> getStarExpression();
+        // see RegularExpressionSimplifier, the first applies every rule
+        RegularExpression simplify() const;
+        RegularExpression simplify(int rules) const;
+
+        // o(1) since equal expressions in a context are the same node
+        bool operator==(const RegularExpression& other) const { return this->node == other.node; };
 
         std::string toString();
         std::string toLatex();
 
+        // write straight to the stream without building intermediate strings
+        void toString(std::ostream& output);
+        void toLatex(std::ostream& output);
+
         void exportExpression(std::string outputDirPath, std::string outputFileName);
 };
 
+class RegularExpressionNode
+{
+    public:
+        RegularExpressionType type;
+
+        char character;
+
+        // concat and plus use both operands, star only uses the first
+        const RegularExpressionNode* operand1;
+        const RegularExpressionNode* operand2;
+
+        // number of nodes in the expression tree (counting shared nodes once per use)
+        size_t nodeCount;
+
+        size_t hash;
+
+        RegularExpressionContext* context;
+};
+
+class RegularExpressionNodeKey
+{
+    public:
+        RegularExpressionType type;
+        char character;
+        const RegularExpressionNode* operand1;
+        const RegularExpressionNode* operand2;
+
+        bool operator==(const RegularExpressionNodeKey&) const = default;
+};
+
+template <>
+struct std::hash<RegularExpressionNodeKey> {
+    size_t operator()(const RegularExpressionNodeKey& key) const;
+};
+
+// arena that owns expression nodes, nodes are bump allocated in chunks and all freed at once with the context (or by reset)
+// scoped work should use a context of its own, the global one only shrinks when it is reset
+// the unique table is split into shards by key, each with its own lock and chunks, so threads interning at once rarely wait on each other
+class RegularExpressionContext
+{
+    private:
+        class Shard
+        {
+            public:
+                std::mutex mutex;
+
+                std::vector<std::unique_ptr<RegularExpressionNode[]>> chunks;
+                int chunkCapacity = 0;
+                int chunkSize = 0;
+
+                std::unordered_map<RegularExpressionNodeKey, const RegularExpressionNode*> uniqueTable;
+        };
+
+        std::array<Shard, 16> shards;
+
+        Shard& getShard(const RegularExpressionNodeKey& key);
+
+    public:
+        RegularExpressionContext() = default;
+
+        RegularExpressionContext(const RegularExpressionContext&) = delete;
+        RegularExpressionContext& operator=(const RegularExpressionContext&) = delete;
+
+        static RegularExpressionContext& global();
+
+        RegularExpression intern(RegularExpressionType type, char character, const RegularExpressionNode* operand1, const RegularExpressionNode* operand2);
+
+        // nodes currently alive, shared nodes count once
+        size_t nodeCount();
+
+        // frees every node at once, every expression built in this context is invalid afterwards
+        void reset();
+};
+
+// combinator grammar for expression strings, built once and never changed afterwards
+// fromExpressionString uses RegularExpressionParser, which accepts the same syntax and builds the same trees without tokens
+// parsing only reads the combinators and keeps its memo and tokens per thread, so one grammar serves every thread at once
+class RegularExpressionGrammar
+{
+    private:
+        ParserCombinator expression;
+        ParserCombinator grammar;
+
+        RegularExpressionGrammar();
+
+    public:
+        // the grammar refers to its own expression member, so it stays put
+        RegularExpressionGrammar(const RegularExpressionGrammar&) = delete;
+        RegularExpressionGrammar& operator=(const RegularExpressionGrammar&) = delete;
+
+        static const RegularExpressionGrammar& get();
+
+        // the whole of expressionStr has to be an expression, the token holds it as its only child
+        ParserCombinatorResult parse(std::string_view expressionStr) const;
+};
+
+template <>
+struct std::hash<RegularExpression> {
+    size_t operator()(const RegularExpression& re) const;
+};
+
 #endif
\ No newline at end of file
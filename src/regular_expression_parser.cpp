@@ -0,0 +1,135 @@
+#include <cctype>
+
+#include "regular_expression_parser.hpp"
+
+// balanced chain
+
+void BalancedChain::add(RegularExpression re)
+{
+    this->blocks.push_back({ re, 1 });
+
+    // two neighbouring blocks of the same size are exactly the pair the next level of buildBalanced would join
+    while (this->blocks.size() >= 2 && this->blocks.back().second == this->blocks[this->blocks.size() - 2].second) {
+        auto [re2, size] = this->blocks.back();
+
+        this->blocks.pop_back();
+
+        this->blocks.back() = { this->combine(this->blocks.back().first, re2), size * 2 };
+    }
+};
+
+RegularExpression BalancedChain::build()
+{
+    // the leftover blocks are joined from the right, the same way buildBalanced carries odd operands up
+    auto re = this->blocks.back().first;
+
+    for (int i = this->blocks.size() - 2;i>=0;i--) re = this->combine(this->blocks[i].first, re);
+
+    return re;
+};
+
+// regular expression parser
+
+std::variant<RegularExpression, ParserFailure> RegularExpressionParser::parse(std::string_view expressionStr)
+{
+    // one frame per open group, the bottom frame is the whole expression
+    class Frame
+    {
+        public:
+            BalancedChain plusChain = BalancedChain(RegularExpression::plus);
+            BalancedChain concatChain = BalancedChain(RegularExpression::concat);
+    };
+
+    std::vector<Frame> frames(1);
+
+    int size = expressionStr.size();
+    int position = 0;
+
+    auto skipWhitespace = [&expressionStr, &position, size] () {
+        while (position < size && expressionStr[position] == ' ') position++;
+    };
+
+    while (true) {
+        // an atom, opening groups until one starts with something else
+        skipWhitespace();
+
+        if (position == size) return ParserFailure(position, "expression");
+
+        char c = expressionStr[position];
+
+        if (c == '(') {
+            frames.emplace_back();
+
+            position++;
+
+            continue;
+        }
+
+        RegularExpression atom;
+
+        if (std::isalnum((unsigned char) c)) atom = RegularExpression::character(this->context, c);
+
+        // λ is two bytes in utf 8
+        else if (c == (char) 206) {
+            if (position + 1 == size || expressionStr[position + 1] != (char) 187) return ParserFailure(position + 1, "λ");
+
+            atom = RegularExpression::empty(this->context);
+
+            position++;
+        }
+
+        else return ParserFailure(position, "expression");
+
+        position++;
+
+        // after an atom, closing groups until the next atom, operator or the end
+        while (true) {
+            if (position < size && expressionStr[position] == '*') {
+                atom = RegularExpression::star(atom);
+
+                position++;
+            }
+
+            frames.back().concatChain.add(atom);
+
+            skipWhitespace();
+
+            if (position == size || expressionStr[position] != ')' || frames.size() == 1) break;
+
+            auto& frame = frames.back();
+
+            frame.plusChain.add(frame.concatChain.build());
+
+            atom = frame.plusChain.build();
+
+            frames.pop_back();
+
+            position++;
+        }
+
+        if (position == size) break;
+
+        c = expressionStr[position];
+
+        if (c == '+') {
+            auto& frame = frames.back();
+
+            frame.plusChain.add(frame.concatChain.build());
+            frame.concatChain = BalancedChain(RegularExpression::concat);
+
+            position++;
+        }
+
+        else if (c == '(' || c == (char) 206 || std::isalnum((unsigned char) c)) continue;
+
+        else return ParserFailure(position, frames.size() == 1 ? "end of input" : "')'");
+    }
+
+    if (frames.size() != 1) return ParserFailure(position, "')'");
+
+    auto& frame = frames.back();
+
+    frame.plusChain.add(frame.concatChain.build());
+
+    return frame.plusChain.build();
+};
@@ -0,0 +1,42 @@
+#ifndef REGULAR_EXPRESSION_PARSER_HPP
+#define REGULAR_EXPRESSION_PARSER_HPP
+
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "regular_expression.hpp"
+
+// operands of a concat or plus chain, joined into the same balanced tree fromToken builds
+// operands are merged as they arrive like a binary counter, so a chain of n operands only keeps log n partial trees
+class BalancedChain
+{
+    private:
+        RegularExpression (*combine)(RegularExpression, RegularExpression);
+
+        // [partial tree, number of operands in it], sizes are powers of two and strictly decrease
+        std::vector<std::pair<RegularExpression, int>> blocks;
+
+    public:
+        BalancedChain(RegularExpression (*combine)(RegularExpression, RegularExpression)): combine(combine) {};
+
+        void add(RegularExpression re);
+
+        RegularExpression build();
+};
+
+// single pass parser for the syntax of RegularExpressionGrammar
+// no backtracking, each character is looked at once, and the only memory beyond the result is one frame per open group
+class RegularExpressionParser
+{
+    private:
+        RegularExpressionContext& context;
+
+    public:
+        RegularExpressionParser(RegularExpressionContext& context): context(context) {};
+
+        // the expression, or where the first character that cant be part of one is
+        std::variant<RegularExpression, ParserFailure> parse(std::string_view expressionStr);
+};
+
+#endif
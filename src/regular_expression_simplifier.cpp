@@ -0,0 +1,290 @@
+#include <unordered_set>
+
+#include "regular_expression_simplifier.hpp"
+
+bool RegularExpressionSimplifier::hasRule(SimplificationRule rule)
+{
+    return this->rules & rule;
+};
+
+std::vector<RegularExpression> RegularExpressionSimplifier::getPlusOperands(RegularExpression re)
+{
+    if (re.getType() != PLUS) return { re };
+
+    if (!this->hasRule(FLATTEN_ASSOCIATIVE)) {
+        auto [re1, re2] = re.getPlusExpression();
+
+        return { re1, re2 };
+    }
+
+    std::vector<RegularExpression> operands;
+
+    std::vector<RegularExpression> stack = { re };
+
+    while (!stack.empty()) {
+        auto currentRe = stack.back();
+
+        stack.pop_back();
+
+        if (currentRe.getType() != PLUS) {
+            operands.push_back(currentRe);
+
+            continue;
+        }
+
+        auto [re1, re2] = currentRe.getPlusExpression();
+
+        stack.push_back(re2);
+        stack.push_back(re1);
+    }
+
+    return operands;
+};
+
+std::vector<RegularExpression> RegularExpressionSimplifier::getConcatOperands(RegularExpression re)
+{
+    if (re.getType() != CONCAT) return { re };
+
+    if (!this->hasRule(FLATTEN_ASSOCIATIVE)) {
+        auto [re1, re2] = re.getConcatExpression();
+
+        return { re1, re2 };
+    }
+
+    std::vector<RegularExpression> operands;
+
+    std::vector<RegularExpression> stack = { re };
+
+    while (!stack.empty()) {
+        auto currentRe = stack.back();
+
+        stack.pop_back();
+
+        if (currentRe.getType() != CONCAT) {
+            operands.push_back(currentRe);
+
+            continue;
+        }
+
+        auto [re1, re2] = currentRe.getConcatExpression();
+
+        stack.push_back(re2);
+        stack.push_back(re1);
+    }
+
+    return operands;
+};
+
+RegularExpression RegularExpressionSimplifier::buildPlus(RegularExpressionContext& context, std::vector<RegularExpression> operands)
+{
+    if (operands.empty()) return RegularExpression::empty(context);
+
+    // right nested, matching how the parser builds chains
+    auto re = operands.back();
+
+    for (int i = operands.size() - 2;i>=0;i--) re = RegularExpression::plus(operands[i], re);
+
+    return re;
+};
+
+RegularExpression RegularExpressionSimplifier::buildConcat(RegularExpressionContext& context, std::vector<RegularExpression> operands)
+{
+    auto re = RegularExpression::empty(context);
+
+    for (int i = operands.size() - 1;i>=0;i--) re = RegularExpression::concat(operands[i], re);
+
+    return re;
+};
+
+std::vector<RegularExpression> RegularExpressionSimplifier::factorPrefixes(RegularExpressionContext& context, std::vector<RegularExpression> operands)
+{
+    // group operands by their first factor, keeping the order each first factor appeared in
+    std::vector<RegularExpression> prefixes;
+    std::unordered_map<RegularExpression, std::vector<RegularExpression>> remainders;
+
+    for (auto operand : operands) {
+        auto factors = this->getConcatOperands(operand);
+
+        auto prefix = factors.front();
+
+        if (!remainders.contains(prefix)) prefixes.push_back(prefix);
+
+        remainders[prefix].push_back(this->buildConcat(context, std::vector<RegularExpression>(factors.begin() + 1, factors.end())));
+    }
+
+    std::vector<RegularExpression> factoredOperands;
+
+    for (auto prefix : prefixes) {
+        auto& prefixRemainders = remainders[prefix];
+
+        if (prefixRemainders.size() == 1) factoredOperands.push_back(RegularExpression::concat(prefix, prefixRemainders[0]));
+        else factoredOperands.push_back(RegularExpression::concat(prefix, this->buildPlus(context, prefixRemainders)));
+    }
+
+    return factoredOperands;
+};
+
+std::vector<RegularExpression> RegularExpressionSimplifier::factorSuffixes(RegularExpressionContext& context, std::vector<RegularExpression> operands)
+{
+    // group operands by their last factor, keeping the order each last factor appeared in
+    std::vector<RegularExpression> suffixes;
+    std::unordered_map<RegularExpression, std::vector<RegularExpression>> remainders;
+
+    for (auto operand : operands) {
+        auto factors = this->getConcatOperands(operand);
+
+        auto suffix = factors.back();
+
+        if (!remainders.contains(suffix)) suffixes.push_back(suffix);
+
+        remainders[suffix].push_back(this->buildConcat(context, std::vector<RegularExpression>(factors.begin(), factors.end() - 1)));
+    }
+
+    std::vector<RegularExpression> factoredOperands;
+
+    for (auto suffix : suffixes) {
+        auto& suffixRemainders = remainders[suffix];
+
+        if (suffixRemainders.size() == 1) factoredOperands.push_back(RegularExpression::concat(suffixRemainders[0], suffix));
+        else factoredOperands.push_back(RegularExpression::concat(this->buildPlus(context, suffixRemainders), suffix));
+    }
+
+    return factoredOperands;
+};
+
+RegularExpression RegularExpressionSimplifier::simplifyPlus(RegularExpression re1, RegularExpression re2)
+{
+    auto& context = re1.getContext();
+
+    auto operands = this->getPlusOperands(re1);
+    auto operands2 = this->getPlusOperands(re2);
+    operands.insert(operands.end(), operands2.begin(), operands2.end());
+
+    if (this->hasRule(IDEMPOTENT_PLUS)) {
+        std::unordered_set<RegularExpression> seenOperands;
+        std::vector<RegularExpression> uniqueOperands;
+
+        for (auto operand : operands) if (seenOperands.insert(operand).second) uniqueOperands.push_back(operand);
+
+        operands = uniqueOperands;
+    }
+
+    if (this->hasRule(LAMBDA_ABSORPTION)) {
+        bool hasStarOperand = false;
+        for (auto operand : operands) if (operand.getType() == STAR) hasStarOperand = true;
+
+        // a starred operand already matches λ
+        if (hasStarOperand) std::erase_if(operands, [] (RegularExpression operand) { return operand.getType() == EMPTY; });
+    }
+
+    if (this->hasRule(FACTOR_PREFIX)) operands = this->factorPrefixes(context, operands);
+    if (this->hasRule(FACTOR_SUFFIX)) operands = this->factorSuffixes(context, operands);
+
+    return this->buildPlus(context, operands);
+};
+
+RegularExpression RegularExpressionSimplifier::simplifyConcat(RegularExpression re1, RegularExpression re2)
+{
+    if (!this->hasRule(FLATTEN_ASSOCIATIVE)) return RegularExpression::concat(re1, re2);
+
+    auto operands = this->getConcatOperands(re1);
+    auto operands2 = this->getConcatOperands(re2);
+    operands.insert(operands.end(), operands2.begin(), operands2.end());
+
+    return this->buildConcat(re1.getContext(), operands);
+};
+
+RegularExpression RegularExpressionSimplifier::simplifyStar(RegularExpression re)
+{
+    auto& context = re.getContext();
+
+    if (this->hasRule(STAR_OF_STAR) && re.getType() == STAR) return re;
+
+    if (this->hasRule(LAMBDA_ABSORPTION) && re.getType() == EMPTY) return re;
+
+    if (re.getType() != PLUS) return RegularExpression::star(re);
+
+    auto operands = this->getPlusOperands(re);
+
+    // the outer star already repeats each operand, so inner stars are redundant
+    if (this->hasRule(STAR_OF_STAR)) {
+        for (auto& operand : operands) if (operand.getType() == STAR) operand = operand.getStarExpression();
+    }
+
+    // the outer star already matches λ
+    if (this->hasRule(LAMBDA_ABSORPTION)) {
+        std::erase_if(operands, [] (RegularExpression operand) { return operand.getType() == EMPTY; });
+
+        if (operands.empty()) return RegularExpression::empty(context);
+    }
+
+    return RegularExpression::star(this->buildPlus(context, operands));
+};
+
+RegularExpression RegularExpressionSimplifier::simplifyOnce(RegularExpression re)
+{
+    this->simplifiedExpressions.clear();
+
+    std::vector<RegularExpression> resultStack;
+
+    // post order traversal, [re, children already visited]
+    std::vector<std::pair<RegularExpression, bool>> traversalStack = { { re, false } };
+
+    while (!traversalStack.empty()) {
+        auto [currentRe, isExpanded] = traversalStack.back();
+
+        traversalStack.pop_back();
+
+        auto type = currentRe.getType();
+
+        if (!isExpanded && this->simplifiedExpressions.contains(currentRe)) resultStack.push_back(this->simplifiedExpressions[currentRe]);
+
+        else if (type == EMPTY || type == CHARACTER) resultStack.push_back(currentRe);
+
+        else if (!isExpanded) {
+            traversalStack.push_back({ currentRe, true });
+
+            if (type == STAR) traversalStack.push_back({ currentRe.getStarExpression(), false });
+
+            else {
+                auto [re1, re2] = type == CONCAT ? currentRe.getConcatExpression() : currentRe.getPlusExpression();
+
+                traversalStack.push_back({ re2, false });
+                traversalStack.push_back({ re1, false });
+            }
+        }
+
+        else {
+            if (type == STAR) resultStack.back() = this->simplifyStar(resultStack.back());
+
+            else {
+                auto re2 = resultStack.back();
+                resultStack.pop_back();
+
+                auto re1 = resultStack.back();
+                resultStack.pop_back();
+
+                resultStack.push_back(type == CONCAT ? this->simplifyConcat(re1, re2) : this->simplifyPlus(re1, re2));
+            }
+
+            this->simplifiedExpressions[currentRe] = resultStack.back();
+        }
+    }
+
+    return resultStack.back();
+};
+
+RegularExpression RegularExpressionSimplifier::simplify(RegularExpression re)
+{
+    // every rule shrinks or reshapes towards a fixed form, the bound is only a guard against a rule set that could cycle
+    for (int pass = 0;pass<64;pass++) {
+        auto simplifiedRe = this->simplifyOnce(re);
+
+        // equal expressions share a node, so this is a pointer compare
+        if (simplifiedRe == re) break;
+
+        re = simplifiedRe;
+    }
+
+    return re;
+};
@@ -0,0 +1,43 @@
+#ifndef REGULAR_EXPRESSION_SIMPLIFIER_HPP
+#define REGULAR_EXPRESSION_SIMPLIFIER_HPP
+
+#include <vector>
+#include <unordered_map>
+
+#include "regular_expression.hpp"
+
+class RegularExpressionSimplifier
+{
+    private:
+        int rules;
+
+        // expressions are dags, so each distinct node is only simplified once per pass
+        std::unordered_map<RegularExpression, RegularExpression> simplifiedExpressions;
+
+        bool hasRule(SimplificationRule rule);
+
+        std::vector<RegularExpression> getPlusOperands(RegularExpression re);
+        std::vector<RegularExpression> getConcatOperands(RegularExpression re);
+
+        RegularExpression buildPlus(RegularExpressionContext& context, std::vector<RegularExpression> operands);
+        RegularExpression buildConcat(RegularExpressionContext& context, std::vector<RegularExpression> operands);
+
+        std::vector<RegularExpression> factorPrefixes(RegularExpressionContext& context, std::vector<RegularExpression> operands);
+        std::vector<RegularExpression> factorSuffixes(RegularExpressionContext& context, std::vector<RegularExpression> operands);
+
+        // these assume their operands are already simplified
+        RegularExpression simplifyPlus(RegularExpression re1, RegularExpression re2);
+        RegularExpression simplifyConcat(RegularExpression re1, RegularExpression re2);
+        RegularExpression simplifyStar(RegularExpression re);
+
+        // one bottom up pass
+        RegularExpression simplifyOnce(RegularExpression re);
+
+    public:
+        RegularExpressionSimplifier(int rules): rules(rules) {};
+
+        // repeats passes until nothing changes
+        RegularExpression simplify(RegularExpression re);
+};
+
+#endif
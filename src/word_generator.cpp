@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <thread>
+
+#include "word_generator.hpp"
+
+// every word gets its own generator seeded from (seed, index), so no word depends on which thread made it or what came before
+// the pair is mixed with splitmix64 steps, a seed_seq per word would cost more than sampling the word
+std::mt19937_64 seededRng(unsigned long long seed, unsigned long long index)
+{
+    auto mix = [] (unsigned long long x) {
+        x += 0x9e3779b97f4a7c15;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+
+        return x ^ (x >> 31);
+    };
+
+    return std::mt19937_64(mix(mix(seed) ^ index));
+};
+
+// word generator
+
+WordGenerator::WordGenerator(FiniteAutomata fa): dfa(IndexedAutomata(fa).determinize())
+{
+    // complete the dfa with a dead state, so rejected words can be counted the same way as accepted ones
+
+    int deadState = this->dfa.getStateCount();
+
+    this->dfa.stateNames.push_back(std::to_string(deadState));
+    this->dfa.acceptingStates.push_back(false);
+    this->dfa.transitions.emplace_back();
+    this->dfa.lambdaTransitions.emplace_back();
+
+    for (int state = 0;state<=deadState;state++) {
+        auto& transitions = this->dfa.transitions[state];
+
+        std::vector<std::pair<char, int>> completedTransitions;
+
+        // both the alphabet and the transitions are sorted, so missing letters are found with a merge
+        int i = 0;
+
+        for (auto c : this->dfa.alphabet) {
+            if (i < transitions.size() && transitions[i].first == c) completedTransitions.push_back(transitions[i++]);
+            else completedTransitions.push_back({ c, deadState });
+        }
+
+        transitions = completedTransitions;
+    }
+
+    std::vector<BigCount> acceptingStates;
+    std::vector<BigCount> rejectingStates;
+
+    for (int state = 0;state<=deadState;state++) {
+        acceptingStates.push_back(this->dfa.acceptingStates[state] ? 1 : 0);
+        rejectingStates.push_back(this->dfa.acceptingStates[state] ? 0 : 1);
+    }
+
+    this->acceptedCounts.push_back(acceptingStates);
+    this->rejectedCounts.push_back(rejectingStates);
+};
+
+void WordGenerator::extendCounts(std::vector<std::vector<BigCount>>& counts, int length)
+{
+    // the same counting as FiniteAutomata::countAccepted, run backwards so every state gets the count of its completions
+
+    int stateCount = this->dfa.getStateCount();
+
+    while (counts.size() <= length) {
+        std::vector<BigCount> nextCounts(stateCount);
+
+        for (int state = 0;state<stateCount;state++) {
+            for (auto [_, endState] : this->dfa.transitions[state]) nextCounts[state] += counts.back()[endState];
+        }
+
+        counts.push_back(std::move(nextCounts));
+    }
+};
+
+void WordGenerator::extendCounts(int length)
+{
+    this->extendCounts(this->acceptedCounts, length);
+    this->extendCounts(this->rejectedCounts, length);
+};
+
+int WordGenerator::step(int state, char c)
+{
+    auto& transitions = this->dfa.transitions[state];
+
+    auto transition = std::lower_bound(transitions.begin(), transitions.end(), std::pair<char, int>(c, -1));
+
+    if (transition == transitions.end() || transition->first != c) return -1;
+
+    return transition->second;
+};
+
+bool WordGenerator::matches(const std::string& word)
+{
+    int state = this->dfa.startState;
+
+    for (auto c : word) {
+        state = this->step(state, c);
+
+        if (state == -1) return false;
+    }
+
+    return this->dfa.acceptingStates[state];
+};
+
+std::optional<std::string> WordGenerator::sampleWord(std::vector<std::vector<BigCount>>& counts, int length, std::mt19937_64& rng)
+{
+    // pick the index of the word among all of them, then walk forward subtracting the completions behind each letter passed over
+    // the completions of a state are exactly the sum over its letters, so the walk always lands on a letter
+
+    int state = this->dfa.startState;
+
+    if (counts[length][state].isZero()) return std::nullopt;
+
+    BigCount target = BigCount::uniformBelow(counts[length][state], rng);
+
+    std::string word;
+
+    for (int remaining = length;remaining>0;remaining--) {
+        auto& remainingCounts = counts[remaining - 1];
+
+        for (auto [c, endState] : this->dfa.transitions[state]) {
+            if (target < remainingCounts[endState]) {
+                word += c;
+                state = endState;
+
+                break;
+            }
+
+            target -= remainingCounts[endState];
+        }
+    }
+
+    return word;
+};
+
+std::optional<std::string> WordGenerator::sampleNearMiss(int length, std::mt19937_64& rng)
+{
+    auto& alphabet = this->dfa.alphabet;
+
+    // a handful of edits usually lands outside the language, dense languages fall through to exact sampling instead
+    const int editAttemptCount = 8;
+
+    for (int attempt = 0;attempt<editAttemptCount && !alphabet.empty();attempt++) {
+        auto acceptedWord = this->sampleWord(this->acceptedCounts, length, rng);
+
+        if (!acceptedWord.has_value()) break;
+
+        auto word = acceptedWord.value();
+
+        auto letter = alphabet[std::uniform_int_distribution<int>(0, alphabet.size() - 1)(rng)];
+
+        int editType = std::uniform_int_distribution<int>(0, word.empty() ? 0 : 2)(rng);
+        int position = std::uniform_int_distribution<int>(0, word.size())(rng);
+
+        if (editType == 0) word.insert(word.begin() + position, letter);
+        else if (editType == 1) word.erase(word.begin() + std::min(position, (int) word.size() - 1));
+        else word[std::min(position, (int) word.size() - 1)] = letter;
+
+        if (!this->matches(word)) return word;
+    }
+
+    return this->sampleWord(this->rejectedCounts, length, rng);
+};
+
+std::optional<std::string> WordGenerator::generateAccepted(int length, unsigned long long seed)
+{
+    this->extendCounts(length);
+
+    auto rng = seededRng(seed, 0);
+
+    return this->sampleWord(this->acceptedCounts, length, rng);
+};
+
+std::optional<std::string> WordGenerator::generateNearMiss(int length, unsigned long long seed)
+{
+    this->extendCounts(length);
+
+    auto rng = seededRng(seed, 0);
+
+    return this->sampleNearMiss(length, rng);
+};
+
+void WordGenerator::enumerateAccepted(int maxLength, std::function<bool(const std::string&)> callback)
+{
+    this->extendCounts(maxLength);
+
+    int stateCount = this->dfa.getStateCount();
+
+    // [remaining][state] = whether some accepted word of at most remaining letters starts at state, used to skip dead branches
+    std::vector<std::vector<bool>> canAccept(maxLength + 1, std::vector<bool>(stateCount, false));
+
+    for (int remaining = 0;remaining<=maxLength;remaining++) {
+        for (int state = 0;state<stateCount;state++) {
+            canAccept[remaining][state] = !this->acceptedCounts[remaining][state].isZero() || (remaining > 0 && canAccept[remaining - 1][state]);
+        }
+    }
+
+    // depth first in letter order, a word is reported before its extensions so the output is lexicographic
+    // only the current word and one frame per letter of it are held, nothing is buffered
+
+    std::string word;
+
+    // [state, index of the next transition to try]
+    std::vector<std::pair<int, int>> stack = { { this->dfa.startState, 0 } };
+
+    if (this->dfa.acceptingStates[this->dfa.startState] && !callback(word)) return;
+
+    while (!stack.empty()) {
+        auto& [state, nextTransition] = stack.back();
+
+        auto& transitions = this->dfa.transitions[state];
+
+        if (nextTransition == transitions.size() || word.size() == maxLength) {
+            stack.pop_back();
+
+            if (!word.empty()) word.pop_back();
+
+            continue;
+        }
+
+        auto [c, endState] = transitions[nextTransition];
+
+        nextTransition++;
+
+        if (!canAccept[maxLength - word.size() - 1][endState]) continue;
+
+        word += c;
+
+        stack.push_back({ endState, 0 });
+
+        if (this->dfa.acceptingStates[endState] && !callback(word)) return;
+    }
+};
+
+std::vector<std::string> WordGenerator::generateCorpus(int wordCount, int length, bool isAccepted, unsigned long long seed)
+{
+    // the tables are only read from here on, so the threads can share them
+    this->extendCounts(length);
+
+    std::vector<std::optional<std::string>> words(wordCount);
+
+    int threadCount = std::max(1, std::min((int) std::thread::hardware_concurrency(), wordCount));
+
+    std::vector<std::thread> threads;
+
+    for (int threadIndex = 0;threadIndex<threadCount;threadIndex++) {
+        threads.emplace_back([this, &words, wordCount, length, isAccepted, seed, threadIndex, threadCount] () {
+            for (int wordIndex = threadIndex;wordIndex<wordCount;wordIndex += threadCount) {
+                auto rng = seededRng(seed, wordIndex);
+
+                words[wordIndex] = isAccepted ? this->sampleWord(this->acceptedCounts, length, rng) : this->sampleNearMiss(length, rng);
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+
+    std::vector<std::string> corpus;
+
+    for (auto& word : words) if (word.has_value()) corpus.push_back(word.value());
+
+    return corpus;
+};
@@ -0,0 +1,54 @@
+#ifndef WORD_GENERATOR_HPP
+#define WORD_GENERATOR_HPP
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <random>
+#include <functional>
+
+#include "finite_automata.hpp"
+#include "indexed_automata.hpp"
+#include "big_count.hpp"
+
+// produces accepted and rejected words of an automata, for test and benchmark corpora
+class WordGenerator
+{
+    private:
+        // determinized and completed with a dead state once up front, so running a word is a single path and reading is thread safe
+        IndexedAutomata dfa;
+
+        // [length][state] = number of accepted / rejected words of that length starting at state
+        // exact, a rare branch next to a common one keeps its true weight however long the words get
+        std::vector<std::vector<BigCount>> acceptedCounts;
+        std::vector<std::vector<BigCount>> rejectedCounts;
+
+        void extendCounts(std::vector<std::vector<BigCount>>& counts, int length);
+        void extendCounts(int length);
+
+        int step(int state, char c);
+        bool matches(const std::string& word);
+
+        // uniform among the words of this length the counts describe, nullopt when there are none
+        std::optional<std::string> sampleWord(std::vector<std::vector<BigCount>>& counts, int length, std::mt19937_64& rng);
+        std::optional<std::string> sampleNearMiss(int length, std::mt19937_64& rng);
+
+    public:
+        WordGenerator(FiniteAutomata fa);
+
+        // uniform among the accepted words of exactly this length, nullopt when there are none
+        std::optional<std::string> generateAccepted(int length, unsigned long long seed);
+
+        // a rejected word one edit (substitution, insertion or deletion) away from an accepted word of about this length
+        // falls back to a uniformly random rejected word of this length, nullopt when every word of this length over the alphabet is accepted
+        std::optional<std::string> generateNearMiss(int length, unsigned long long seed);
+
+        // accepted words up to maxLength in lexicographic order, stops early once the callback returns false
+        void enumerateAccepted(int maxLength, std::function<bool(const std::string&)> callback);
+
+        // wordCount words generated in parallel, word i only depends on (seed, i) so the corpus is the same for any thread count
+        // words that cannot be generated are left out
+        std::vector<std::string> generateCorpus(int wordCount, int length, bool isAccepted, unsigned long long seed);
+};
+
+#endif
@@ -1,7 +1,13 @@
 #include <catch2/catch_all.hpp>
 #include <bitset>
+#include <sstream>
 
 #include "../src/finite_automata.hpp"
+#include "../src/derivative_automata.hpp"
+#include "../src/word_generator.hpp"
+#include "../src/regular_expression_parser.hpp"
+#include "../src/lexical_scanner.hpp"
+#include "../lib/static_parser.hpp"
 
 TEST_CASE("CONSTRUCTIONS") {
     // str -> re
@@ -285,12 +291,23 @@ TEST_CASE("CONSTRUCTIONS") {
 
     auto input8 = FiniteAutomata::create(input8_states, input8_startState, input8_acceptingStates, input8_edges);
 
-    for (int i = 0;i<10*m;i++) {
-        auto expectedOutput8 = n.contains(i % m);
-        auto observedOutput8 = input8.matches(std::bitset<8>(i).to_string());
-        
-        REQUIRE(expectedOutput8 == observedOutput8);
-    }
+    // every accepted binary numeral of at most 8 digits, which should be exactly the numbers congruent to n mod m
+    int observedOutput8 = 0;
+
+    WordGenerator(input8).enumerateAccepted(8, [&] (const std::string& word) {
+        REQUIRE(input8.matches(word));
+        REQUIRE(n.contains(std::stoi(word, nullptr, 2) % m));
+
+        observedOutput8++;
+
+        return true;
+    });
+
+    int expectedOutput8 = 0;
+
+    for (int length = 1;length<=8;length++) for (int i = 0;i<(1 << length);i++) expectedOutput8 += n.contains(i % m);
+
+    REQUIRE(observedOutput8 == expectedOutput8);
 }
 
 // https://people.cs.umass.edu/~barring/cs250f24/exams/finsol.pdf
@@ -533,6 +550,794 @@ TEST_CASE("S24") {
     REQUIRE(FiniteAutomata::isLanguageEquivalence(expectedOutput6e, observedOutput6e));
 }
 
+TEST_CASE("OPTIMIZATIONS") {
+    // lnfa -> compact nfa
+
+    auto input1 = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a* + b)*(ab + λ)* + (λ + c)*a"));
+    auto observedOutput1 = input1.lnfa2compactNfa();
+
+    REQUIRE(!observedOutput1.hasLambdaMoves());
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input1, observedOutput1));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input1.lnfa2nfa(), observedOutput1));
+
+    // λ cycles collapse into single states instead of being copied around
+    auto input1Cycles = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(((a + λ)*(b + λ)*)* c)*"));
+
+    auto observedOutput1Compact = IndexedAutomata(input1Cycles.lnfa2compactNfa());
+    auto expectedOutput1Full = IndexedAutomata(input1Cycles.lnfa2nfa());
+
+    auto countEdges = [] (IndexedAutomata& fa) {
+        int edgeCount = 0;
+
+        for (auto& stateTransitions : fa.transitions) edgeCount += stateTransitions.size();
+
+        return edgeCount;
+    };
+
+    REQUIRE(observedOutput1Compact.getStateCount() < expectedOutput1Full.getStateCount());
+    REQUIRE(countEdges(observedOutput1Compact) < countEdges(expectedOutput1Full));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input1Cycles.lnfa2nfa(), input1Cycles.lnfa2compactNfa()));
+
+    // re -> lnfa keeps adjacent stars from looping into each other
+
+    auto input2 = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("a*b*(c + d*)*")).lnfa2nfa().nfa2dfa();
+
+    REQUIRE(input2.matches("aabbcdc"));
+    REQUIRE(input2.matches(""));
+    REQUIRE(!input2.matches("ba"));
+    REQUIRE(!input2.matches("ca"));
+    REQUIRE(!input2.matches("db"));
+
+    // re -> nfa (glushkov)
+
+    for (auto input3 : {
+        "a (b (b* + a + λ) + λ(a + (ab + b + λ)* bb)) b(ab)*",
+        "ab*(a+b(a+λ)) + (a + λ)",
+        "((a*)* + λ)(b + ab)*a*",
+        "λ"
+    }) {
+        auto re = RegularExpression::fromExpressionString(input3);
+        auto observedOutput3 = FiniteAutomata::re2nfa(re);
+
+        REQUIRE(!observedOutput3.hasLambdaMoves());
+        REQUIRE(FiniteAutomata::isLanguageEquivalence(FiniteAutomata::re2lnfa(re), observedOutput3));
+    }
+
+    // re -> dfa (brzozowski)
+
+    auto input4 = RegularExpression::fromExpressionString("(a + b)*abb(a + b)* + (ab)*");
+    auto expectedOutput4 = FiniteAutomata::re2lnfa(input4).lnfa2nfa().nfa2dfa().dfa2minDfa();
+    auto observedOutput4 = FiniteAutomata::re2dfa(input4);
+
+    REQUIRE(observedOutput4.isDeterministic());
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(expectedOutput4, observedOutput4));
+
+    auto lazyInput4 = DerivativeAutomata(input4);
+
+    // every word of at most 8 letters, the accepted ones from the dfa and the rejected ones from its complement
+    int observedOutput4Words = 0;
+
+    WordGenerator(expectedOutput4).enumerateAccepted(8, [&] (const std::string& word) {
+        REQUIRE(lazyInput4.matches(word));
+
+        observedOutput4Words++;
+
+        return true;
+    });
+
+    WordGenerator(expectedOutput4.dfa2complement()).enumerateAccepted(8, [&] (const std::string& word) {
+        REQUIRE(!lazyInput4.matches(word));
+
+        observedOutput4Words++;
+
+        return true;
+    });
+
+    REQUIRE(observedOutput4Words == (1 << 9) - 1);
+
+    REQUIRE(!lazyInput4.matches("abc"));
+
+    // long concat chains and deep nesting stay off the call stack
+    std::string input4Long;
+
+    for (int i = 0;i<200000;i++) input4Long += "ab"[i % 3 == 0];
+
+    auto observedOutput4Long = FiniteAutomata::re2dfa(RegularExpression::fromExpressionString(input4Long));
+
+    REQUIRE(observedOutput4Long.matches(input4Long));
+    REQUIRE(!observedOutput4Long.matches(input4Long + "a"));
+
+    std::string input4Nested;
+
+    for (int i = 0;i<20000;i++) input4Nested += "(a + b";
+
+    input4Nested += "c" + std::string(20000, ')');
+
+    auto lazyInput4Nested = DerivativeAutomata(RegularExpression::fromExpressionString(input4Nested));
+
+    REQUIRE(lazyInput4Nested.matches("bba"));
+    REQUIRE(!lazyInput4Nested.matches("bbc"));
+
+    // lnfa -> re with each state elimination ordering
+
+    std::unordered_set<std::string> input5_states;
+    std::unordered_set<Edge> input5_edges;
+
+    // binary numbers divisible by 7
+    for (int i = 0;i<7;i++) {
+        input5_states.insert(std::to_string(i));
+
+        input5_edges.insert(Edge(std::to_string(i), std::to_string((2 * i) % 7), '0'));
+        input5_edges.insert(Edge(std::to_string(i), std::to_string((2 * i + 1) % 7), '1'));
+    }
+
+    auto input5 = FiniteAutomata::create(input5_states, "0", { "0" }, input5_edges);
+
+    std::unordered_map<StateEliminationOrdering, size_t> observedOutput5Sizes;
+
+    for (auto ordering : { ARBITRARY, MIN_DEGREE_PRODUCT, MIN_WEIGHT, DYNAMIC_MIN_WEIGHT }) {
+        auto observedOutput5 = input5.lnfa2re(ordering);
+
+        REQUIRE(FiniteAutomata::isLanguageEquivalence(input5, FiniteAutomata::re2lnfa(observedOutput5)));
+
+        observedOutput5Sizes[ordering] = observedOutput5.size();
+    }
+
+    // the heuristics are opt in, and recomputing weights as states go gives the smallest expression here
+    REQUIRE(input5.lnfa2re() == input5.lnfa2re(ARBITRARY));
+    REQUIRE(observedOutput5Sizes[MIN_WEIGHT] <= observedOutput5Sizes[ARBITRARY]);
+    REQUIRE(observedOutput5Sizes[DYNAMIC_MIN_WEIGHT] < observedOutput5Sizes[ARBITRARY]);
+    REQUIRE(observedOutput5Sizes[DYNAMIC_MIN_WEIGHT] < observedOutput5Sizes[MIN_DEGREE_PRODUCT]);
+
+    // hash consed regular expressions
+
+    auto input6a = RegularExpression::fromExpressionString("(ab + b)*a");
+    auto input6b = RegularExpression::concat(
+        RegularExpression::star(RegularExpression::plus(
+            RegularExpression::concat(RegularExpression::character('a'), RegularExpression::character('b')),
+            RegularExpression::character('b')
+        )),
+        RegularExpression::character('a')
+    );
+
+    REQUIRE(input6a == input6b);
+    REQUIRE(std::hash<RegularExpression>()(input6a) == std::hash<RegularExpression>()(input6b));
+    REQUIRE(!(input6a == RegularExpression::fromExpressionString("(ab + b)*b")));
+    REQUIRE(input6a.getConcatExpression().first.getStarExpression() == RegularExpression::fromExpressionString("ab + b"));
+
+    // arena backed expression contexts
+
+    {
+        RegularExpressionContext context;
+
+        auto input7 = RegularExpression::fromExpressionString(context, "(ab + b)*a");
+        auto observedOutput7 = input5.lnfa2re(DYNAMIC_MIN_WEIGHT, context);
+
+        REQUIRE(&input7.getContext() == &context);
+        REQUIRE(&observedOutput7.getContext() == &context);
+        REQUIRE(input7.toString() == input6a.toString());
+        REQUIRE(!(input7 == input6a));
+        REQUIRE(FiniteAutomata::isLanguageEquivalence(input5, FiniteAutomata::re2lnfa(observedOutput7)));
+
+        REQUIRE_THROWS(RegularExpression::plus(input7, input6a));
+
+        auto input7NodeCount = context.nodeCount();
+
+        RegularExpression::star(RegularExpression::concat(input7, RegularExpression::character(context, '#')));
+
+        REQUIRE(context.nodeCount() == input7NodeCount + 3);
+    }
+
+    // temporaries go in a context of their own, which frees them all at once without touching the global context
+    auto input7GlobalNodeCount = RegularExpressionContext::global().nodeCount();
+
+    {
+        RegularExpressionContext context;
+
+        for (int i = 0;i<2000;i++) RegularExpression::fromExpressionString(context, "a" + std::to_string(i) + "(b + c)*d");
+
+        REQUIRE(context.nodeCount() > 2000);
+
+        context.reset();
+
+        REQUIRE(context.nodeCount() == 0);
+        REQUIRE(RegularExpression::fromExpressionString(context, "(b + c)*d").toString() == "(b+c)*d");
+    }
+
+    REQUIRE(RegularExpressionContext::global().nodeCount() == input7GlobalNodeCount);
+
+    // regular expression simplification
+
+    std::vector<std::pair<std::string, std::string>> input8 = {
+        { "(a*)*", "a*" },
+        { "λ + a*", "a*" },
+        { "(λ + a + b*)*", "(a+b)*" },
+        { "a + b + a", "a+b" },
+        { "ab + ac", "a(b+c)" },
+        { "ba + ca", "(b+c)a" },
+        { "λ*", "λ" },
+    };
+
+    for (auto [input, expectedOutput8] : input8) {
+        auto observedOutput8 = RegularExpression::fromExpressionString(input).simplify();
+
+        REQUIRE(observedOutput8.toString() == expectedOutput8);
+    }
+
+    auto input9 = input5.lnfa2re(ARBITRARY);
+    auto observedOutput9 = input9.simplify();
+
+    REQUIRE(observedOutput9.size() <= input9.size());
+    REQUIRE(observedOutput9.simplify() == observedOutput9);
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input5, FiniteAutomata::re2lnfa(observedOutput9)));
+    REQUIRE(RegularExpression::fromExpressionString("(a + b)a").simplify(IDEMPOTENT_PLUS) == RegularExpression::fromExpressionString("(a + b)a"));
+
+    // conversions only simplify when asked to
+    REQUIRE(input5.lnfa2re(ARBITRARY, RegularExpressionContext::global(), true) == observedOutput9);
+
+    auto input9Nested = RegularExpression::fromExpressionString("((a*)* + λ)*");
+
+    REQUIRE(IndexedAutomata(FiniteAutomata::re2lnfa(input9Nested, true)).getStateCount() < IndexedAutomata(FiniteAutomata::re2lnfa(input9Nested)).getStateCount());
+
+    // dfa -> min dfa when every state is accepting
+
+    auto input10 = FiniteAutomata::create(
+        { "A", "B" },
+        "A",
+        { "A", "B" },
+        {
+            Edge("A", "A", 'a'),
+            Edge("A", "B", 'b'),
+            Edge("B", "B", 'b'),
+        }
+    );
+    auto observedOutput10 = input10.dfa2minDfa();
+
+    REQUIRE(FiniteAutomata::isIsomorphism(input10, observedOutput10));
+    REQUIRE(!observedOutput10.matches("ba"));
+
+    // the first refinement splits the single initial class into exactly two, which must not look like convergence
+    auto input10Chain = FiniteAutomata::create(
+        { "A", "B", "C" },
+        "A",
+        { "A", "B", "C" },
+        {
+            Edge("A", "B", 'a'),
+            Edge("B", "C", 'a')
+        }
+    );
+    auto observedOutput10Chain = input10Chain.dfa2minDfa();
+
+    REQUIRE(FiniteAutomata::isIsomorphism(input10Chain, observedOutput10Chain));
+    REQUIRE(observedOutput10Chain.matches("aa"));
+    REQUIRE(!observedOutput10Chain.matches("aaa"));
+
+    // str -> re -> str with a long machine generated alternation
+
+    std::string input11;
+    std::string expectedOutput11;
+
+    for (int i = 0;i<50000;i++) {
+        std::string word = { (char) ('a' + i % 26), (char) ('a' + i / 26 % 26), (char) ('a' + i / 676 % 26), (char) ('a' + i / 17576) };
+
+        input11 += (i == 0 ? "" : " + ") + word;
+        expectedOutput11 += (i == 0 ? "" : "+") + word;
+    }
+
+    auto observedOutput11 = RegularExpression::fromExpressionString(input11);
+
+    REQUIRE(observedOutput11.toString() == expectedOutput11);
+    REQUIRE(DerivativeAutomata(observedOutput11).matches("zyxb"));
+    REQUIRE(!DerivativeAutomata(observedOutput11).matches("zzzz"));
+
+    // streaming emitters
+
+    auto input12a = RegularExpression::fromExpressionString("(a + λ)*b");
+    std::ostringstream observedOutput12a;
+
+    input12a.toLatex(observedOutput12a);
+
+    REQUIRE(observedOutput12a.str().find("$ (a+\\lambda)^*b $") != std::string::npos);
+    REQUIRE(observedOutput12a.str() == input12a.toLatex());
+
+    auto input12b = FiniteAutomata::create(
+        { "A", "B" },
+        "A",
+        { "B" },
+        {
+            Edge("A", "B", 'a'),
+            Edge("A", "B", 'b'),
+        }
+    );
+    std::ostringstream observedOutput12b;
+
+    input12b.toDOT(observedOutput12b);
+
+    REQUIRE(observedOutput12b.str() == input12b.toDOT());
+    REQUIRE(observedOutput12b.str().contains("\"A\" -> \"B\" [label=\"a,b\"];"));
+    REQUIRE(observedOutput12b.str().contains("\"B\" [penwidth=5];"));
+
+    // sorted, so the output is the same across runs and builds
+    auto input12c = FiniteAutomata::create(
+        { "C", "A", "B" },
+        "A",
+        { "C", "B" },
+        {
+            Edge("B", "C", 'b'),
+            Edge("A", "C", std::nullopt),
+            Edge("A", "B", 'b'),
+            Edge("A", "B", 'a')
+        }
+    );
+
+    REQUIRE(input12c.toString() == "States: A, B, C\nStart State: A\nAccepting States: B, C\nEdges: \n\tFrom A via a to B\n\tFrom A via b to B\n\tFrom A via λ to C\n\tFrom B via b to C");
+    REQUIRE(input12c.toDOT().contains("\t\"B\" [penwidth=5];\n\t\"C\" [penwidth=5];\n\t\"A\" -> \"B\" [label=\"a,b\"];\n\t\"A\" -> \"C\" [label=\"λ\"];\n\t\"B\" -> \"C\" [label=\"b\"];\n}"));
+
+    // shortest counterexamples
+
+    auto input13a = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*abb"));
+    auto input13b = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*ab"));
+    auto input13c = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("a*"));
+    auto input13d = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(aa)*"));
+
+    REQUIRE(FiniteAutomata::findCounterexample(input13a, input13b) == "ab");
+    REQUIRE(FiniteAutomata::findCounterexample(input13c, input13d) == "a");
+    REQUIRE(FiniteAutomata::findCounterexample(input13c, input13c.lnfa2nfa().nfa2dfa()) == std::nullopt);
+    REQUIRE(FiniteAutomata::findCounterexample(input13d, FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("λ + aa(aa)*"))) == std::nullopt);
+
+    // language inclusion
+
+    auto input14a = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*abb"));
+    auto input14b = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*b"));
+
+    REQUIRE(FiniteAutomata::isLanguageIncluded(input14a, input14b));
+    REQUIRE(FiniteAutomata::findInclusionCounterexample(input14b, input14a) == "b");
+    REQUIRE(FiniteAutomata::isLanguageIncluded(input13d, input13c));
+    REQUIRE(!FiniteAutomata::isLanguageEquivalence(input13c, input13d, ANTICHAIN));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input5, FiniteAutomata::re2lnfa(input9), ANTICHAIN));
+
+    // lazy products
+
+    auto input15a = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*a"));
+    auto input15b = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("a(a + b)*"));
+
+    auto observedOutput15a = input15a.intersect(input15b);
+    auto observedOutput15b = input15a.unite(input15b, true);
+    auto observedOutput15c = input15a.difference(input15b);
+    auto observedOutput15d = input15a.symmetricDifference(input15b);
+
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(observedOutput15a, FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("a + a(a + b)*a"))));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(observedOutput15b, FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*a + a(a + b)*"))));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(observedOutput15c, FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("b(a + b)*a"))));
+    REQUIRE(observedOutput15d.matches("ba"));
+    REQUIRE(observedOutput15d.matches("ab"));
+    REQUIRE(!observedOutput15d.matches("aba"));
+    REQUIRE(FiniteAutomata::isIntersectionEmpty(input13c, FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("bb*"))));
+    REQUIRE(!FiniteAutomata::isIntersectionEmpty(input15a, input15b));
+
+    // language queries
+
+    auto input16 = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*"));
+
+    REQUIRE(input5.countAccepted(12) == "586");
+    REQUIRE(input5.countAccepted(12, 100) == 86);
+    REQUIRE(input16.countAccepted(100) == "1267650600228229401496703205376");
+    REQUIRE(input16.isUniversal());
+    REQUIRE(!input15a.isUniversal());
+    REQUIRE(!input16.isFinite());
+    REQUIRE(FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("ab + ba + λ")).isFinite());
+    REQUIRE(input14a.shortestAcceptedWord() == "abb");
+    REQUIRE(observedOutput15c.shortestAcceptedWord() == "ba");
+    REQUIRE(!input14a.isEmpty());
+    REQUIRE(input15a.intersect(FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("bb*"))).isEmpty());
+
+    // word generators
+
+    WordGenerator generator17a(input16);
+    std::vector<std::string> observedOutput17a;
+
+    generator17a.enumerateAccepted(3, [&observedOutput17a] (const std::string& word) {
+        observedOutput17a.push_back(word);
+
+        return true;
+    });
+
+    REQUIRE(observedOutput17a.size() == 15);
+    REQUIRE(observedOutput17a[1] == "a");
+    REQUIRE(observedOutput17a[3] == "aaa");
+    REQUIRE(std::is_sorted(observedOutput17a.begin(), observedOutput17a.end()));
+
+    WordGenerator generator17b(expectedOutput4);
+
+    auto observedOutput17b = generator17b.generateCorpus(500, 12, true, 17);
+    auto observedOutput17c = generator17b.generateCorpus(500, 12, false, 17);
+
+    REQUIRE(observedOutput17b == generator17b.generateCorpus(500, 12, true, 17));
+    REQUIRE(observedOutput17b.size() == 500);
+    REQUIRE(observedOutput17c.size() == 500);
+
+    for (auto word : observedOutput17b) REQUIRE((word.size() == 12 && lazyInput4.matches(word) && expectedOutput4.matches(word)));
+    for (auto word : observedOutput17c) REQUIRE((!lazyInput4.matches(word) && !expectedOutput4.matches(word)));
+
+    WordGenerator generator17c(input14a);
+    std::unordered_set<std::string> observedOutput17d;
+
+    for (int seed = 0;seed<64;seed++) observedOutput17d.insert(generator17c.generateAccepted(4, seed).value());
+
+    REQUIRE(observedOutput17d == std::unordered_set<std::string>({ "aabb", "babb" }));
+    REQUIRE(generator17c.generateAccepted(2, 0) == std::nullopt);
+
+    // counts are exact, a single rejected word is still found next to the 2^1100 words that complete the unreachable dead state
+    WordGenerator generator17d(FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("b*a(a + b)*")));
+
+    REQUIRE(generator17d.generateNearMiss(1100, 0) == std::string(1100, 'b'));
+    REQUIRE(generator17d.generateAccepted(1100, 0).value().size() == 1100);
+    REQUIRE(FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("b*a(a + b)*")).countAccepted(100) == "1267650600228229401496703205375");
+
+    // canonical forms and fingerprints
+
+    std::vector<std::string> input18 = {
+        "(a + b)*",
+        "(a*b*)*",
+        "a*(ba*)*",
+        "(a + b)*abb",
+        "(a + b)*ab(b + λ)b",
+        "(a + b)*ab(b + bb)"
+    };
+
+    std::unordered_map<LanguageFingerprint, std::vector<std::string>> observedOutput18;
+
+    for (auto str : input18) observedOutput18[FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString(str)).fingerprint()].push_back(str);
+
+    REQUIRE(observedOutput18.size() == 3);
+    REQUIRE(observedOutput18[input16.fingerprint()].size() == 3);
+    REQUIRE(observedOutput18[input14a.fingerprint()] == std::vector<std::string>({ "(a + b)*abb" }));
+
+    auto observedOutput18a = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*ab(b + λ)b")).canonicalize();
+    auto observedOutput18b = FiniteAutomata::re2lnfa(RegularExpression::fromExpressionString("(a + b)*ab(b + bb)")).canonicalize();
+
+    REQUIRE(observedOutput18[observedOutput18a.fingerprint()].size() == 2);
+    REQUIRE(FiniteAutomata::isIsomorphism(observedOutput18a, observedOutput18b));
+    REQUIRE(FiniteAutomata::isLanguageEquivalence(input14a, input14a.canonicalize(), FINGERPRINT));
+    REQUIRE(!FiniteAutomata::isLanguageEquivalence(input14a, input14b, FINGERPRINT));
+
+    // packrat parsing
+
+    auto input19 = std::string(200, '(') + "a + b" + std::string(200, ')') + "*";
+
+    REQUIRE(RegularExpression::fromExpressionString(input19).toString() == "(a+b)*");
+
+    auto letter = satisfy("LETTER", isalpha);
+    auto input19Grammar = choice({
+        sequence("PAIR", { letter, letter }),
+        letter.followedBy("STARRED", satisfy(is('*'))),
+        letter
+    }).repeatedly();
+
+    auto observedOutput19a = parse("ab*cde", input19Grammar, PACKRAT);
+    auto observedOutput19b = parse("ab*cde", input19Grammar, DIRECT);
+
+    REQUIRE(getResultType(observedOutput19a) == TOKEN);
+    REQUIRE(getTokenFromResult(observedOutput19a).toString() == getTokenFromResult(observedOutput19b).toString());
+
+    // a call on another string in the middle of a parse must not share the memo of the parse input
+    auto input19Probe = std::string("xyz*");
+    auto input19Nested = ParserCombinator([&] (const std::string& str, const int start) -> ParserCombinatorResult {
+        input19Grammar(input19Probe, start);
+
+        return input19Grammar(str, start);
+    });
+
+    REQUIRE(getTokenFromResult(parse("ab*cde", input19Nested, PACKRAT)).toString() == getTokenFromResult(observedOutput19b).toString());
+    REQUIRE(getTokenFromResult(parse("a*bc", strictlySequence({ input19Grammar }), PACKRAT)).toString() == getTokenFromResult(parse("a*bc", sequence({ input19Grammar }))).toString());
+
+    // statically typed combinators
+
+    auto typedLetter = static_parser::satisfy("LETTER", [] (char c) { return std::isalpha(c) != 0; });
+    auto input20Grammar = static_parser::choice(
+        static_parser::sequence("PAIR", typedLetter, typedLetter),
+        typedLetter.followedBy("STARRED", static_parser::satisfy(static_parser::is('*'))),
+        typedLetter
+    ).repeatedly();
+
+    for (std::string str : { "ab*cde", "a*b*c", "", "*ab", "abc1de" }) {
+        auto observedOutput20 = input20Grammar(str, 0);
+        auto expectedOutput20 = parse(str, input19Grammar);
+
+        REQUIRE(getTokenFromResult(observedOutput20).toString() == getTokenFromResult(expectedOutput20).toString());
+        REQUIRE(input20Grammar.match(str, 0) == getTokenFromResult(expectedOutput20).width);
+    }
+
+    // erased into a dynamic grammar and back
+    auto input20Dynamic = sequence("LIST", { input20Grammar.erase(), string(";") });
+    auto input20Typed = static_parser::sequence("LIST", static_parser::dynamic(input19Grammar), static_parser::string(";"));
+
+    REQUIRE(getTokenFromResult(parse("a*bc;", input20Dynamic)).toString() == getTokenFromResult(input20Typed("a*bc;", 0)).toString());
+    REQUIRE(getParserFailureFromResult(input20Typed("a*bc", 0)).start == getParserFailureFromResult(parse("a*bc", input20Dynamic)).start);
+    REQUIRE(input20Typed.match("a*bc", 0) == -1);
+
+    // both read the terminating null at the end of the input
+    auto input20NullTyped = sequence("END", { string("ab"), static_parser::satisfy("NULL", static_parser::is('\0')).erase() });
+    auto input20NullDynamic = sequence("END", { string("ab"), satisfy("NULL", is('\0')) });
+
+    REQUIRE(getResultType(parse("ab", input20NullTyped)) == TOKEN);
+    REQUIRE(getTokenFromResult(parse("ab", input20NullTyped)).toString() == getTokenFromResult(parse("ab", input20NullDynamic)).toString());
+    REQUIRE(static_parser::satisfy(static_parser::is('\0')).match("ab", 2) == 3);
+    REQUIRE(getResultType(parse("abc", input20NullTyped)) == PARSER_FAILURE);
+
+    // arena backed tokens
+
+    auto observedOutput21 = getTokenFromResult(parse(std::string("a*bc"), input19Grammar));
+    auto observedOutput21Children = observedOutput21.getNestingContent();
+
+    REQUIRE(observedOutput21Children.size() == 2);
+    REQUIRE(observedOutput21Children[0].kind == Token::internKind("STARRED"));
+    REQUIRE(observedOutput21Children[1].getId() == "PAIR");
+    REQUIRE(observedOutput21Children[1].getNestingContent()[1].getStringLiteralContent() == "c");
+    REQUIRE(observedOutput21.contentString() == "abc");
+
+    auto expectedOutput21 = Token("PAIR", std::vector<Token>({ Token("LETTER", "b", 2, 1), Token("LETTER", "c", 3, 1) }), 2, 2);
+
+    REQUIRE(observedOutput21Children[1].toString() == expectedOutput21.toString());
+
+    // a copied child keeps the arena alive after the root is gone
+    auto input21Pair = sequence("PAIR", { letter, letter });
+
+    auto observedOutput21a = [&] {
+        Token root = getTokenFromResult(input21Pair("ab", 0));
+
+        return Token(root.getNestingContent()[1]);
+    }();
+    auto observedOutput21b = [&] {
+        Token root = getTokenFromResult(parse(std::string("a*bc"), input19Grammar));
+
+        return Token(root.getNestingContent()[1]);
+    }();
+    auto observedOutput21c = [] {
+        Token root("PAIR", std::vector<Token>({ Token("LETTER", "b", 2, 1), Token("LETTER", "c", 3, 1) }), 2, 2);
+
+        return Token(root.getNestingContent()[0]);
+    }();
+
+    REQUIRE(observedOutput21a.getStringLiteralContent() == "b");
+    REQUIRE(observedOutput21b.toString() == expectedOutput21.toString());
+    REQUIRE(observedOutput21c.getStringLiteralContent() == "b");
+
+    // batch parsing with the shared grammar
+
+    std::vector<std::string> input22;
+
+    for (int i = 0;i<200;i++) input22.push_back(input18[i % input18.size()] + " + " + std::string(i % 7, 'a') + "b*");
+
+    auto observedOutput22 = RegularExpression::fromExpressionStrings(input22);
+
+    REQUIRE(observedOutput22.size() == input22.size());
+
+    for (int i = 0;i<input22.size();i++) REQUIRE(observedOutput22[i] == RegularExpression::fromExpressionString(input22[i]));
+
+    input22[150] = "(a + b";
+
+    REQUIRE_THROWS_WITH(RegularExpression::fromExpressionStrings(input22), Catch::Matchers::ContainsSubstring("expression 150"));
+    REQUIRE(getResultType(RegularExpressionGrammar::get().parse(std::string_view("ab)").substr(0, 2))) == TOKEN);
+
+    // dedicated expression parser
+
+    std::vector<std::string> input23 = {
+        "a",
+        " ( a )* ",
+        "ab*(a+b(a+λ)) + (a + λ)",
+        "a (b (b* + a + λ) + λ(a + (ab + b + λ)* bb)) b(ab)*",
+        "(((λ)))*a b  c+d",
+        input19
+    };
+
+    for (auto str : input23) {
+        auto expectedOutput23 = RegularExpression::fromToken(getTokenFromResult(RegularExpressionGrammar::get().parse(str)).getNestingContent()[0]);
+
+        REQUIRE(std::get<RegularExpression>(RegularExpressionParser(RegularExpressionContext::global()).parse(str)) == expectedOutput23);
+    }
+
+    std::vector<std::pair<std::string, int>> input23Failures = {
+        { "(a + b", 6 },
+        { "a**", 2 },
+        { "a + ", 4 },
+        { "()", 1 },
+        { "a)", 1 },
+        { "", 0 }
+    };
+
+    for (auto [str, expectedOutput23] : input23Failures) {
+        auto observedOutput23 = RegularExpressionParser(RegularExpressionContext::global()).parse(str);
+
+        REQUIRE(std::get<ParserFailure>(observedOutput23).start == expectedOutput23);
+    }
+
+    auto input23Nested = std::string(100000, '(') + "a" + std::string(100000, ')') + "*";
+
+    REQUIRE(RegularExpression::fromExpressionString(input23Nested) == RegularExpression::star(RegularExpression::character('a')));
+
+    // pooled concurrent choice
+
+    ParserCombinator input24Concurrent;
+    ParserCombinator input24Sequential;
+
+    auto input24Atom = [&letter] (ParserCombinator* expression, auto choose) {
+        return choose({
+            letter,
+            sequence("GROUP", { satisfy(is('(')), proxyParserCombinator(expression), satisfy(is(')')) }),
+            sequence("PAIR", { letter, letter })
+        });
+    };
+
+    auto input24ConcurrentAtom = input24Atom(&input24Concurrent, choiceConcurrent);
+    auto input24SequentialAtom = input24Atom(&input24Sequential, choice);
+
+    input24Concurrent = choiceConcurrent({ input24ConcurrentAtom.repeatedly(1), sequence("SUM", { input24ConcurrentAtom, satisfy(is('+')), input24ConcurrentAtom }) });
+    input24Sequential = choice({ input24SequentialAtom.repeatedly(1), sequence("SUM", { input24SequentialAtom, satisfy(is('+')), input24SequentialAtom }) });
+
+    // reaching the end of the text does not settle the choice, a later alternative can still match the terminating null
+    auto input24Terminated = [] (auto choose) {
+        return choose({ string("A", "ab"), sequence("B", { string("ab"), satisfy(is('\0')) }) });
+    };
+
+    for (int i = 0;i<20;i++) REQUIRE(getTokenFromResult(parse("ab", input24Terminated(choiceConcurrent))).toString() == getTokenFromResult(parse("ab", input24Terminated(choice))).toString());
+
+    for (std::string str : { "a+b", "ab(cd)e", "(a+(b+c))+d", "((ab)(c+d))", "a+", "(a+b" }) {
+        auto observedOutput24 = parse(str, input24Concurrent);
+        auto expectedOutput24 = parse(str, input24Sequential);
+
+        REQUIRE(getResultType(observedOutput24) == getResultType(expectedOutput24));
+
+        if (getResultType(expectedOutput24) == TOKEN) REQUIRE(getTokenFromResult(observedOutput24).toString() == getTokenFromResult(expectedOutput24).toString());
+        else REQUIRE(getParserFailureFromResult(observedOutput24).start == getParserFailureFromResult(expectedOutput24).start);
+    }
+
+    // an alternative that throws, wherever it runs, reaches the caller once the other alternatives are done
+    auto input24Throwing = ParserCombinator([] (const std::string& str, const int start) -> ParserCombinatorResult {
+        throw std::runtime_error("input24Throwing: " + std::string(1, str[start]));
+    });
+
+    for (int i = 0;i<4;i++) {
+        std::vector<ParserCombinator> input24Alternatives(8, input24ConcurrentAtom);
+
+        input24Alternatives[i * 2 + 1] = input24Throwing;
+
+        REQUIRE_THROWS_WITH(parse("ab(", choiceConcurrent(input24Alternatives).repeatedly()), "input24Throwing: a");
+    }
+
+    REQUIRE(getResultType(parse("(a+b)", input24Concurrent)) == TOKEN);
+
+    // first character dispatch
+
+    auto digit = satisfy("DIGIT", CharClass(isdigit));
+    auto input25Alternatives = std::vector<ParserCombinator>({
+        sequence("PAIR", { letter, letter }).named("pair"),
+        string("KEYWORD", "let").named("let"),
+        digit.repeatedly(1).named("number"),
+        sequence("SIGNED", { optional(satisfy(is('-'))), digit }).named("signed")
+    });
+
+    REQUIRE(input25Alternatives[1].getFirstSet().count() == 1);
+    REQUIRE(input25Alternatives[1].getFirstSet().test('l'));
+    REQUIRE(input25Alternatives[2].getFirstSet().count() == 10);
+    REQUIRE(input25Alternatives[3].getFirstSet().count() == 11);
+    REQUIRE(!input25Alternatives[3].isNullable());
+    REQUIRE(optional(digit).isNullable());
+    REQUIRE(proxyParserCombinator(&input25Alternatives[0]).getFirstSet().all());
+    REQUIRE(satisfy(isdigit).getFirstSet().all());
+
+    // declaring every byte hides the first sets, so this choice runs every alternative like before
+    std::vector<ParserCombinator> input25Undeclared;
+
+    for (auto alternative : input25Alternatives) input25Undeclared.push_back(alternative.withFirstSet(std::bitset<256>().set(), true));
+
+    auto input25Dispatched = choice(input25Alternatives).repeatedly(1);
+    auto input25Scanned = choice(input25Undeclared).repeatedly(1);
+
+    for (std::string str : { "let", "ab12", "-4ab", "lex", "", "-", "+1", "12-3let" }) {
+        auto observedOutput25 = parse(str, input25Dispatched);
+        auto expectedOutput25 = parse(str, input25Scanned);
+
+        REQUIRE(getResultType(observedOutput25) == getResultType(expectedOutput25));
+
+        if (getResultType(expectedOutput25) == TOKEN) REQUIRE(getTokenFromResult(observedOutput25).toString() == getTokenFromResult(expectedOutput25).toString());
+        else REQUIRE(getParserFailureFromResult(observedOutput25).toString() == getParserFailureFromResult(expectedOutput25).toString());
+    }
+
+    // compiled char classes
+
+    auto whitespace = anyOf({ is(' '), is('\t'), is('\n') });
+    auto identifier = CharClass(isalnum) | is('_');
+
+    REQUIRE(whitespace.getBytes().count() == 3);
+    REQUIRE(identifier('_'));
+    REQUIRE(!identifier('-'));
+    REQUIRE((identifier & negate(CharClass(isdigit))).getBytes().count() == 53);
+    REQUIRE(noneOf({ whitespace, is('"') }).getBytes().count() == 252);
+    REQUIRE((~whitespace)('a'));
+
+    auto input26 = std::string(37, ' ') + "\t\n" + std::string(20, ' ') + "x" + std::string(40, 'a') + "\"";
+
+    REQUIRE(whitespace.scan(input26.data(), input26.data() + input26.size()) == 59);
+    REQUIRE(whitespace.scan(input26.data(), input26.data() + 10) == 10);
+    REQUIRE(noneOf({ is('"') }).scan(input26.data(), input26.data() + input26.size()) == input26.size() - 1);
+    REQUIRE(identifier.scan(input26.data() + 59, input26.data() + input26.size()) == 41);
+
+    // too many members and too many non members to index either side
+    auto input26Wide = std::string("  abcdefghijklmnopqrstuvwxyz0123456789");
+
+    REQUIRE((~CharClass(isalnum)).scan(input26Wide.data(), input26Wide.data() + input26Wide.size()) == 2);
+    REQUIRE(negate(CharClass(isdigit)).scan(input26Wide.data(), input26Wide.data() + input26Wide.size()) == 28);
+    REQUIRE(CharClass(std::bitset<256>().set()).scan(input26Wide.data(), input26Wide.data() + input26Wide.size()) == input26Wide.size());
+    REQUIRE(getTokenFromResult(parse(input26Wide, satisfy(~CharClass(isalnum)).repeatedly())).width == 2);
+
+    // any other predicate is still called per byte, so it can depend on more than the character
+    char input26Quote = '"';
+    auto input26Quoted = satisfy("ANY", noneOf({ [&input26Quote] (const char& c) { return c == input26Quote; }, is('\n') })).repeatedly();
+
+    REQUIRE(getTokenFromResult(parse("ab'c\"", input26Quoted)).width == 4);
+
+    input26Quote = '\'';
+
+    REQUIRE(getTokenFromResult(parse("ab'c\"", input26Quoted)).width == 2);
+    REQUIRE(getTokenFromResult(parse("ab\nc\"", input26Quoted)).width == 2);
+
+    // repetitions scan runs of single byte combinators, these hide the class behind a plain function to compare against
+    auto hideCharClass = [] (ParserCombinator tokenGenerator) {
+        return ParserCombinator([tokenGenerator] (const std::string& str, const int start) { return tokenGenerator(str, start); }).withFirstSet(tokenGenerator.getFirstSet(), false);
+    };
+
+    std::vector<std::pair<ParserCombinator, ParserCombinator>> input26Grammars = {
+        { sequence({ satisfy(whitespace).repeatedly(), satisfy("ID", identifier).repeatedly(1) }), sequence({ hideCharClass(satisfy(whitespace)).repeatedly(), hideCharClass(satisfy("ID", identifier)).repeatedly(1) }) },
+        { satisfy("ANY", negate(is('"'))).named("any").repeatedly(0, 45), hideCharClass(satisfy("ANY", negate(is('"')))).repeatedly(0, 45) },
+        { satisfy(whitespace).strictlyRepeatedly(), hideCharClass(satisfy(whitespace)).strictlyRepeatedly() },
+        { satisfy("OTHER", ~identifier).repeatedly(), hideCharClass(satisfy("OTHER", ~identifier)).repeatedly() }
+    };
+
+    for (auto [grammar, expectedGrammar] : input26Grammars) {
+        for (std::string str : { input26, input26.substr(0, 30), input26.substr(59), std::string("") }) {
+            auto observedOutput26 = parse(str, grammar);
+            auto expectedOutput26 = parse(str, expectedGrammar);
+
+            REQUIRE(getResultType(observedOutput26) == getResultType(expectedOutput26));
+
+            if (getResultType(expectedOutput26) == TOKEN) REQUIRE(getTokenFromResult(observedOutput26).toString() == getTokenFromResult(expectedOutput26).toString());
+            else REQUIRE(getParserFailureFromResult(observedOutput26).toString() == getParserFailureFromResult(expectedOutput26).toString());
+        }
+    }
+
+    // lexical sub grammars compiled to dfas
+
+    auto input27Number = sequence({ optional(satisfy(is('-'))), digit.repeatedly(1), optional(sequence({ string("."), digit.repeatedly(1) })) });
+    auto input27Letter = satisfy("LETTER", CharClass(isalpha));
+    auto input27Keyword = choice({ string("let"), string("letter"), input27Letter.repeatedly(1) });
+    auto input27Greedy = sequence({ input27Letter.repeatedly(), input27Letter });
+
+    REQUIRE(LexicalScanner::compile(input27Number).has_value());
+    REQUIRE(LexicalScanner::compile(input27Keyword)->getStateCount() == 2);
+    REQUIRE(LexicalScanner::compile(input27Number)->match("-12.5e", 0) == 5);
+    REQUIRE(LexicalScanner::compile(input27Number)->match("12.", 0) == 2);
+
+    // the repetition takes every letter, so the combinator fails where the longest match of its language would not
+    REQUIRE(!LexicalScanner::compile(input27Greedy).has_value());
+    REQUIRE(!LexicalScanner::compile(input24Sequential).has_value());
+
+    for (auto grammar : { input27Number, input27Keyword, input27Greedy }) {
+        for (std::string str : { "-12.5e", "12.", "-", "letters1", "let", "", "x" }) {
+            auto observedOutput27 = parse(str, lexical("LEXEME", grammar));
+            auto expectedOutput27 = parse(str, grammar);
+
+            REQUIRE(getResultType(observedOutput27) == getResultType(expectedOutput27));
+
+            if (getResultType(expectedOutput27) == TOKEN) {
+                REQUIRE(getTokenFromResult(observedOutput27).getStringLiteralContent() == str.substr(0, getTokenFromResult(expectedOutput27).width));
+                REQUIRE(getTokenFromResult(observedOutput27).getId() == "LEXEME");
+            }
+            else REQUIRE(getParserFailureFromResult(observedOutput27).toString() == getParserFailureFromResult(expectedOutput27).toString());
+        }
+    }
+}
+
 int main() {
     return Catch::Session().run();
 }
\ No newline at end of file